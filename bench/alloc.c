@@ -0,0 +1,156 @@
+/* Allocation check - Evaluations that must not allocate
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "arithmo.h"
+
+#define CHECK_ROUNDS 10000
+#define CHECK_ROWS 64
+#define CHECK_TEXTS 4
+
+typedef struct {
+  artm_calc_t* calc;
+  artm_expr_t* expr;
+  artm_exprset_t* set;
+  artm_var_t vars[3];
+  double column[CHECK_ROWS];
+  double results[CHECK_ROWS];
+} check_t;
+
+typedef void (*check_run_t)(check_t* check, size_t round);
+
+static atomic_size_t allocations;
+
+// Counts every call that may take memory from the heap
+static void* allocate(size_t size, void* payload) {
+  (void) payload;
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  return malloc(size);
+}
+
+static void* reallocate(void* pointer, size_t size, void* payload) {
+  (void) payload;
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  return realloc(pointer, size);
+}
+
+static void release(void* pointer, void* payload) {
+  (void) payload;
+  free(pointer);
+}
+
+static const char* texts[CHECK_TEXTS] = {
+  "x * (y - 2) + sqrt(z)",
+  "max(x, y) / (1 + z * z)",
+  "-(x + y + z) * 3.5",
+  "f * 2 + x"
+};
+
+static void repeated_text(check_t* check, size_t round) {
+  artm_calc_eval(check->calc, texts[round % CHECK_TEXTS]);
+}
+
+static void declaration(check_t* check, size_t round) {
+  artm_calc_eval(check->calc, round % 2 == 0 ? "$x = 1.5" : "$x = 2.5");
+}
+
+static void compiled(check_t* check, size_t round) {
+  (void) round;
+  artm_expr_eval(check->expr);
+}
+
+static void batch(check_t* check, size_t round) {
+  (void) round;
+  artm_column_t column = { .var = check->vars[0], .data = check->column };
+  artm_expr_eval_batch(check->expr, &column, 1, check->results, CHECK_ROWS);
+}
+
+static void formula_set(check_t* check, size_t round) {
+  (void) round;
+  artm_result_t results[CHECK_TEXTS];
+  artm_exprset_eval(check->set, results);
+}
+
+static void gradient(check_t* check, size_t round) {
+  (void) round;
+  double derivatives[3];
+  artm_expr_eval_grad(check->expr, check->vars, 3, derivatives);
+}
+
+static const struct {
+  const char* name;
+  check_run_t run;
+} checks[] = {
+  { "repeated text", repeated_text },
+  { "declaration", declaration },
+  { "compiled", compiled },
+  { "batch", batch },
+  { "formula set", formula_set },
+  { "gradient", gradient }
+};
+
+// Every path runs once before it is counted, so that the expression cache
+// and the lazily grown buffers are warm. Any allocation after that fails
+extern int main(void) {
+  atomic_init(&allocations, 0);
+  artm_config_t config = {
+    .decl_table_size = 64,
+    .cache_capacity = 16,
+    .allocator = ARTM_ALLOCATOR(allocate, reallocate, release, NULL)
+  };
+
+  check_t check = { .calc = artm_calc_init_ex(&config) };
+  artm_calc_eval(check.calc, "$x = 1.5");
+  artm_calc_eval(check.calc, "$y = -2");
+  artm_calc_eval(check.calc, "$z = 7");
+  artm_calc_eval(check.calc, "$f := x * y");
+  check.vars[0] = artm_calc_var(check.calc, "x");
+  check.vars[1] = artm_calc_var(check.calc, "y");
+  check.vars[2] = artm_calc_var(check.calc, "z");
+  check.expr = artm_calc_compile(check.calc, texts[0], NULL);
+  check.set = artm_calc_compile_set(check.calc, texts, CHECK_TEXTS, NULL);
+  for (size_t i = 0; i < CHECK_ROWS; ++i)
+    check.column[i] = (double) i / 8;
+  if (check.expr == NULL || check.set == NULL) {
+    fprintf(stderr, "compilation failed\n");
+    return EXIT_FAILURE;
+  }
+
+  size_t failed = 0;
+  for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i) {
+    for (size_t round = 0; round < CHECK_TEXTS * 2; ++round)
+      checks[i].run(&check, round);
+
+    size_t before = atomic_load_explicit(&allocations, memory_order_relaxed);
+    for (size_t round = 0; round < CHECK_ROUNDS; ++round)
+      checks[i].run(&check, round);
+    size_t count = atomic_load_explicit(&allocations, memory_order_relaxed) - before;
+
+    printf("%-14s %8zu allocations in %d evaluations\n", checks[i].name, count, CHECK_ROUNDS);
+    failed += count != 0;
+  }
+
+  artm_exprset_free(check.set);
+  artm_expr_free(check.expr);
+  artm_calc_free(check.calc);
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
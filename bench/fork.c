@@ -0,0 +1,107 @@
+/* Fork benchmark - Per-request scopes over environments of growing size
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "arithmo.h"
+
+#define BENCH_MAX_VARIABLES 1000000
+#define BENCH_SIZE 48
+#define BENCH_REQUESTS 200000
+#define BENCH_COPIES 5
+#define BENCH_ROUNDS 5
+
+static const size_t sizes[] = { 1000, 100000, BENCH_MAX_VARIABLES };
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static double keep(double time, double best, int round) {
+  return round == 0 || time < best ? time : best;
+}
+
+// One request: two overrides, one evaluation that also reads the parent
+static double request(artm_calc_t* base, double qty) {
+  artm_calc_t* calc = artm_calc_fork(base);
+  artm_var_set(artm_calc_var(calc, "qty"), qty);
+  artm_calc_eval(calc, "$rate = 0.25");
+  double value = artm_calc_eval(calc, "price * qty * (1 + rate) + v7").as.value;
+  artm_calc_free(calc);
+  return value;
+}
+
+// The alternative to a fork: a fresh calc loaded with the whole environment
+static double copy(const char* const* names, const double* values, size_t count, double qty) {
+  artm_calc_t* calc = artm_calc_init(0);
+  artm_calc_set_vars(calc, names, values, count);
+  artm_calc_eval(calc, "$price = 4");
+  artm_var_set(artm_calc_var(calc, "qty"), qty);
+  artm_calc_eval(calc, "$rate = 0.25");
+  double value = artm_calc_eval(calc, "price * qty * (1 + rate) + v7").as.value;
+  artm_calc_free(calc);
+  return value;
+}
+
+extern int main(void) {
+  static char names[BENCH_MAX_VARIABLES][BENCH_SIZE];
+  static const char* pointers[BENCH_MAX_VARIABLES];
+  static double values[BENCH_MAX_VARIABLES];
+
+  for (size_t i = 0; i < BENCH_MAX_VARIABLES; ++i) {
+    snprintf(names[i], BENCH_SIZE, "v%zu", i);
+    pointers[i] = names[i];
+    values[i] = (double) i;
+  }
+
+  size_t wrong = 0;
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    artm_calc_t* base = artm_calc_init(0);
+    artm_calc_set_vars(base, pointers, values, sizes[s]);
+    artm_calc_eval(base, "$price = 4");
+    artm_calc_eval(base, "$qty = 1");
+    artm_calc_eval(base, "$rate = 0");
+
+    double fork = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+      double start = now();
+      for (size_t i = 0; i < BENCH_REQUESTS; ++i)
+        wrong += request(base, (double) (i % 8)) != 4 * (double) (i % 8) * 1.25 + 7;
+      fork = keep((now() - start) / BENCH_REQUESTS, fork, round);
+    }
+
+    double start = now();
+    for (size_t i = 0; i < BENCH_COPIES; ++i)
+      wrong += copy(pointers, values, sizes[s], 2) != 4 * 2 * 1.25 + 7;
+    double fresh = (now() - start) / BENCH_COPIES;
+
+    // The parent must not see the overrides of its forks
+    wrong += artm_calc_eval(base, "qty + rate").as.value != 1;
+    artm_calc_free(base);
+
+    printf("%8zu variables: fork %8.0f ns/request, fresh calc %12.0f ns/request\n", sizes[s], fork, fresh);
+  }
+
+  printf("%zu wrong results\n", wrong);
+  return wrong != 0;
+}
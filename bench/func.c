@@ -0,0 +1,168 @@
+/* Function benchmark - Accuracy and throughput of the built-in functions
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arithmo.h"
+#include "kernels.h"
+
+#define BENCH_ROWS 4096
+#define BENCH_ROUNDS 200
+
+typedef struct bench_func bench_func_t;
+
+struct bench_func {
+  const char* expression;
+  double (*reference)(double, double);
+  kernel_func_t kernel;
+};
+
+static double ref_sqrt(double x, double y) { (void) y; return sqrt(x); }
+static double ref_abs(double x, double y) { (void) y; return fabs(x); }
+static double ref_floor(double x, double y) { (void) y; return floor(x); }
+static double ref_ceil(double x, double y) { (void) y; return ceil(x); }
+static double ref_exp(double x, double y) { (void) y; return exp(x); }
+static double ref_log(double x, double y) { (void) y; return log(x); }
+static double ref_sin(double x, double y) { (void) y; return sin(x); }
+static double ref_fmin(double x, double y) { return fmin(x, y); }
+static double ref_fmax(double x, double y) { return fmax(x, y); }
+
+static const bench_func_t funcs[] = {
+  { "sqrt(x)", ref_sqrt, KERNEL_SQRT },
+  { "abs(x)", ref_abs, KERNEL_ABS },
+  { "floor(x)", ref_floor, KERNEL_FLOOR },
+  { "ceil(x)", ref_ceil, KERNEL_CEIL },
+  { "min(x, y)", ref_fmin, KERNEL_MIN },
+  { "max(x, y)", ref_fmax, KERNEL_MAX },
+  { "exp(x)", ref_exp, KERNEL_NONE },
+  { "log(x)", ref_log, KERNEL_NONE },
+  { "sin(x)", ref_sin, KERNEL_NONE }
+};
+
+static const double specials[] = { 0.0, -0.0, 1.0, -1.0, 0.5, -0.5, 2.5, -2.5, 1e308, 5e-324, INFINITY, -INFINITY, NAN };
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+// Equal bits, except for the payload of NaNs
+static int same(double a, double b) {
+  return memcmp(&a, &b, sizeof(double)) == 0 || (isnan(a) && isnan(b));
+}
+
+// min and max only differ from fmin and fmax on the sign of equal zeros
+static int accurate(const bench_func_t* func, double x, double y, double value) {
+  double expected = func->reference(x, y);
+  if (func->kernel == KERNEL_MIN || func->kernel == KERNEL_MAX)
+    return value == expected || (isnan(value) && isnan(expected));
+  return same(value, expected);
+}
+
+static size_t check_kernels(const bench_func_t* func, const double* xs, const double* ys, double* out) {
+  static const char* const sets[] = { "scalar", "sse2", "avx2", "avx512" };
+  size_t mismatches = 0;
+  for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]) && func->kernel != KERNEL_NONE; ++i) {
+    const kernels_t* kernels = kernels_find(sets[i]);
+    if (kernels == NULL)
+      continue;
+
+    if (kernels->unary_func[func->kernel] != NULL) {
+      kernels->unary_func[func->kernel](out, xs, BENCH_ROWS);
+    } else if (kernels->binary_func[func->kernel] != NULL) {
+      kernels->binary_func[func->kernel](out, xs, ys, BENCH_ROWS);
+    } else {
+      continue;
+    }
+
+    for (size_t row = 0; row < BENCH_ROWS; ++row) {
+      if (!accurate(func, xs[row], ys[row], out[row])) {
+        fprintf(stderr, "%s (%s): %a, %a -> %a\n", func->expression, sets[i], xs[row], ys[row], out[row]);
+        ++mismatches;
+      }
+    }
+  }
+  return mismatches;
+}
+
+extern int main(void) {
+  artm_calc_t* calc = artm_calc_init(2);
+  artm_var_t x = artm_calc_var(calc, "x");
+  artm_var_t y = artm_calc_var(calc, "y");
+
+  static double xs[BENCH_ROWS], ys[BENCH_ROWS], out[BENCH_ROWS];
+  size_t count = sizeof(specials) / sizeof(specials[0]);
+  srand(42);
+  for (size_t row = 0; row < BENCH_ROWS; ++row) {
+    xs[row] = row < count * count ? specials[row / count] : (rand() - RAND_MAX / 2) / 2e7;
+    ys[row] = row < count * count ? specials[row % count] : (rand() - RAND_MAX / 2) / 2e7;
+  }
+
+  artm_column_t columns[] = { { x, xs }, { y, ys } };
+  size_t mismatches = 0;
+  double sum = 0;
+  printf("%-10s %10s %12s %12s\n", "function", "mismatches", "row ns", "batch ns");
+  for (size_t i = 0; i < sizeof(funcs) / sizeof(funcs[0]); ++i) {
+    const bench_func_t* func = &funcs[i];
+    artm_expr_t* expr = artm_calc_compile(calc, func->expression, NULL);
+
+    // Every path has to give the same value as the C library
+    size_t errors = check_kernels(func, xs, ys, out);
+    artm_expr_eval_batch(expr, columns, 2, out, BENCH_ROWS);
+    for (size_t row = 0; row < BENCH_ROWS; ++row) {
+      artm_var_set(x, xs[row]);
+      artm_var_set(y, ys[row]);
+      double value = artm_expr_eval(expr).as.value;
+      if (!accurate(func, xs[row], ys[row], value) || !same(value, out[row])) {
+        fprintf(stderr, "%s: %a, %a -> %a (batch %a)\n", func->expression, xs[row], ys[row], value, out[row]);
+        ++errors;
+      }
+    }
+    mismatches += errors;
+
+    double start = now();
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+      for (size_t row = 0; row < BENCH_ROWS; ++row) {
+        artm_var_set(x, xs[row]);
+        artm_var_set(y, ys[row]);
+        sum += artm_expr_eval(expr).as.value;
+      }
+    }
+    double rows = (now() - start) / (BENCH_ROUNDS * BENCH_ROWS);
+
+    start = now();
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+      artm_expr_eval_batch(expr, columns, 2, out, BENCH_ROWS);
+      sum -= out[round];
+    }
+    double batch = (now() - start) / (BENCH_ROUNDS * BENCH_ROWS);
+
+    printf("%-10.*s %10zu %12.2f %12.2f\n", (int) strcspn(func->expression, "("), func->expression, errors, rows, batch);
+    artm_expr_free(expr);
+  }
+
+  artm_calc_free(calc);
+  printf("checksum %g\n", sum);
+  return mismatches != 0;
+}
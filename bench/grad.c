@@ -0,0 +1,118 @@
+/* Gradient benchmark - Forward-mode derivatives against finite differences
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arithmo.h"
+
+#define BENCH_MAX_VARIABLES 64
+#define BENCH_SIZE 16
+#define BENCH_TERM_SIZE 64
+#define BENCH_ROUNDS 5
+#define BENCH_TOLERANCE 1e-6
+
+static const size_t sizes[] = { 4, 16, BENCH_MAX_VARIABLES };
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static double keep(double time, double best, int round) {
+  return round == 0 || time < best ? time : best;
+}
+
+// The central difference needs two evaluations per variable, plus the value
+static void differences(const artm_expr_t* expr, const artm_var_t* vars, size_t count, double* gradient) {
+  gradient[count] = artm_expr_eval(expr).as.value;
+  for (size_t i = 0; i < count; ++i) {
+    double value = artm_var_get(vars[i]);
+    double step = 1e-6 * fmax(1, fabs(value));
+    artm_var_set(vars[i], value + step);
+    double above = artm_expr_eval(expr).as.value;
+    artm_var_set(vars[i], value - step);
+    double below = artm_expr_eval(expr).as.value;
+    artm_var_set(vars[i], value);
+    gradient[i] = (above - below) / (2 * step);
+  }
+}
+
+extern int main(void) {
+  static char names[BENCH_MAX_VARIABLES][BENCH_SIZE];
+  static char expression[BENCH_MAX_VARIABLES * BENCH_TERM_SIZE];
+  artm_var_t vars[BENCH_MAX_VARIABLES];
+  double expected[BENCH_MAX_VARIABLES + 1];
+  double gradient[BENCH_MAX_VARIABLES];
+
+  size_t wrong = 0;
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    size_t count = sizes[s];
+    artm_calc_t* calc = artm_calc_init(0);
+
+    // A chain of terms, each one reading three neighbouring variables
+    expression[0] = '\0';
+    for (size_t i = 0; i < count; ++i) {
+      snprintf(names[i], BENCH_SIZE, "x%zu", i);
+      vars[i] = artm_calc_var(calc, names[i]);
+      artm_var_set(vars[i], 0.5 + (double) i / (double) count);
+
+      char term[BENCH_TERM_SIZE];
+      size_t next = (i + 1) % count, other = (i + 2) % count;
+      snprintf(term, BENCH_TERM_SIZE, "%ssin(x%zu) * x%zu + x%zu / (1 + x%zu * x%zu)",
+        i == 0 ? "" : " + ", i, next, i, other, other);
+      strcat(expression, term);
+    }
+
+    artm_expr_t* expr = artm_calc_compile(calc, expression, NULL);
+    size_t evals = 200000 / count;
+
+    double finite = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+      double start = now();
+      for (size_t i = 0; i < evals; ++i)
+        differences(expr, vars, count, expected);
+      finite = keep((now() - start) / (double) evals, finite, round);
+    }
+
+    double forward = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+      double start = now();
+      for (size_t i = 0; i < evals; ++i)
+        wrong += artm_expr_eval_grad(expr, vars, count, gradient).as.value != expected[count];
+      forward = keep((now() - start) / (double) evals, forward, round);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+      wrong += fabs(gradient[i] - expected[i]) > BENCH_TOLERANCE * fmax(1, fabs(expected[i]));
+
+    artm_expr_free(expr);
+    artm_calc_free(calc);
+
+    printf("%2zu variables: finite differences %8.0f ns/gradient, forward mode %8.0f ns/gradient (%.1fx)\n",
+      count, finite, forward, finite / forward);
+  }
+
+  printf("%zu wrong results\n", wrong);
+  return wrong != 0;
+}
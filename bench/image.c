@@ -0,0 +1,122 @@
+/* Image benchmark - Cold start from source text and from an image
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arithmo.h"
+
+#define BENCH_EXPRESSIONS 200000
+#define BENCH_VARIABLES 1000
+#define BENCH_SIZE 128
+#define BENCH_ROUNDS 5
+#define BENCH_PATH "image_bench.bin"
+
+static const char* const shapes[] = {
+  "v%d * (v%d - %d.25) + v%d / 4",
+  "sqrt(v%d * v%d + %d) - min(v%d, 0)",
+  "-(v%d + v%d) * %d + max(v%d, 1)",
+  "(v%d - v%d) / (v%d + %d.5)"
+};
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+static artm_calc_t* new_calc(void) {
+  artm_calc_t* calc = artm_calc_init(BENCH_VARIABLES);
+  char name[16];
+  for (int i = 0; i < BENCH_VARIABLES; ++i) {
+    snprintf(name, sizeof(name), "v%d", i);
+    artm_var_set(artm_calc_var(calc, name), (double) i / 7);
+  }
+  return calc;
+}
+
+static int same(artm_result_t a, artm_result_t b) {
+  return a.status == b.status
+    && (a.status != ARTM_SUCCESS || memcmp(&a.as.value, &b.as.value, sizeof(double)) == 0);
+}
+
+static void free_all(artm_expr_t** exprs) {
+  for (size_t i = 0; i < BENCH_EXPRESSIONS; ++i)
+    artm_expr_free(exprs[i]);
+}
+
+// The best of a few rounds, since both sides are dominated by the allocator
+extern int main(void) {
+  static char sources[BENCH_EXPRESSIONS][BENCH_SIZE];
+  static artm_expr_t* compiled[BENCH_EXPRESSIONS];
+  static artm_expr_t* loaded[BENCH_EXPRESSIONS];
+
+  srand(42);
+  for (size_t i = 0; i < BENCH_EXPRESSIONS; ++i) {
+    int a = rand() % BENCH_VARIABLES, b = rand() % BENCH_VARIABLES, c = rand() % BENCH_VARIABLES;
+    snprintf(sources[i], BENCH_SIZE, shapes[i % 4], a, b, rand() % 100, c);
+  }
+
+  artm_calc_t* calc = new_calc();
+  double best = 0;
+  for (int round = 0; round < BENCH_ROUNDS; ++round) {
+    if (round > 0)
+      free_all(compiled);
+    double start = now();
+    for (size_t i = 0; i < BENCH_EXPRESSIONS; ++i)
+      compiled[i] = artm_calc_compile(calc, sources[i], NULL);
+    double time = now() - start;
+    best = round == 0 || time < best ? time : best;
+  }
+  printf("compile %10.1f ms\n", best);
+
+  double start = now();
+  artm_status_t status = artm_expr_save((const artm_expr_t* const*) compiled, BENCH_EXPRESSIONS, BENCH_PATH);
+  printf("save    %10.1f ms\n", now() - start);
+
+  artm_calc_t* cold = new_calc();
+  for (int round = 0; status == ARTM_SUCCESS && round < BENCH_ROUNDS; ++round) {
+    if (round > 0)
+      free_all(loaded);
+    start = now();
+    status = artm_expr_load(cold, BENCH_PATH, loaded, BENCH_EXPRESSIONS);
+    double time = now() - start;
+    best = round == 0 || time < best ? time : best;
+  }
+  printf("load    %10.1f ms\n", best);
+  remove(BENCH_PATH);
+
+  size_t mismatches = 0;
+  for (size_t i = 0; status == ARTM_SUCCESS && i < BENCH_EXPRESSIONS; ++i) {
+    if (!same(artm_expr_eval(compiled[i]), artm_expr_eval(loaded[i]))) {
+      fprintf(stderr, "mismatch: %s\n", sources[i]);
+      ++mismatches;
+    }
+  }
+  printf("checked %10d expressions, %zu mismatches\n", BENCH_EXPRESSIONS, mismatches);
+
+  free_all(compiled);
+  if (status == ARTM_SUCCESS)
+    free_all(loaded);
+  artm_calc_free(calc);
+  artm_calc_free(cold);
+  return status != ARTM_SUCCESS || mismatches != 0;
+}
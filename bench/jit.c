@@ -0,0 +1,140 @@
+/* JIT bench - Native code against the bytecode interpreter
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arithmo.h"
+
+#define BENCH_EXPRESSIONS 20000
+#define BENCH_SIZE 512
+#define BENCH_DEPTH 5
+#define BENCH_HOT 64
+#define BENCH_ROUNDS 100000
+
+static const char* const names[] = { "x", "y", "z", "w" };
+static const double values[] = { 1.5, -0.0, 1e308, 3e-310, -7.25, 0 };
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static size_t generate(char* buffer, size_t size, int depth) {
+  int choice = rand() % (depth >= BENCH_DEPTH ? 3 : 7);
+  switch (choice) {
+    case 0:
+      return (size_t) snprintf(buffer, size, "%d.%d", rand() % 100, rand() % 100);
+    case 1:
+      return (size_t) snprintf(buffer, size, "%s", names[rand() % 4]);
+    case 2:
+      return (size_t) snprintf(buffer, size, "%d", rand() % 3);
+    case 3:
+      buffer[0] = '-';
+      return 1 + generate(buffer + 1, size - 1, depth + 1);
+    case 4: {
+      buffer[0] = '(';
+      size_t length = 1 + generate(buffer + 1, size - 2, depth + 1);
+      buffer[length] = ')';
+      return length + 1;
+    }
+    default: {
+      size_t length = generate(buffer, size, depth + 1);
+      length += (size_t) snprintf(buffer + length, size - length, " %c ", "+-*/"[rand() % 4]);
+      return length + generate(buffer + length, size - length, depth + 1);
+    }
+  }
+}
+
+// The tokens point into two copies of the same text, so they are at the
+// same place exactly when the rest of the text from them is the same
+static int same(artm_result_t a, artm_result_t b) {
+  if (a.status != b.status)
+    return 0;
+  return a.status == ARTM_SUCCESS
+    ? memcmp(&a.as.value, &b.as.value, sizeof(double)) == 0
+    : a.as.token.size == b.as.token.size && strcmp(a.as.token.target, b.as.token.target) == 0;
+}
+
+extern int main(void) {
+  // Without the expression cache artm_calc_eval always compiles and runs the bytecode
+  artm_config_t config = { .decl_table_size = 4, .cache_capacity = 0 };
+  artm_calc_t* calc = artm_calc_init_ex(&config);
+  artm_var_t vars[] = {
+    artm_calc_var(calc, "x"), artm_calc_var(calc, "y"),
+    artm_calc_var(calc, "z"), artm_calc_var(calc, "w")
+  };
+
+  static char sources[BENCH_EXPRESSIONS][BENCH_SIZE];
+  static artm_expr_t* interpreted[BENCH_EXPRESSIONS];
+  static artm_expr_t* native[BENCH_EXPRESSIONS];
+
+  // Every JIT result has to match the bytecode bit for bit,
+  // including the errors of the (at first) undeclared w
+  srand(42);
+  size_t mismatches = 0;
+  for (size_t i = 0; i < BENCH_EXPRESSIONS; ++i) {
+    sources[i][generate(sources[i], BENCH_SIZE - 1, 0)] = '\0';
+    interpreted[i] = artm_calc_compile_ex(calc, sources[i], ARTM_OPT_NONE, NULL);
+    native[i] = artm_calc_compile_ex(calc, sources[i], ARTM_OPT_JIT, NULL);
+
+    for (size_t j = 0; j < 4; ++j) {
+      for (size_t k = 0; k < 3; ++k)
+        artm_var_set(vars[k], values[(i + j + k) % 6]);
+      if (j == 2)
+        artm_var_set(vars[3], values[i % 6]);
+
+      if (!same(artm_calc_eval(calc, sources[i]), artm_expr_eval(native[i]))) {
+        fprintf(stderr, "mismatch: %s\n", sources[i]);
+        ++mismatches;
+      }
+    }
+  }
+  printf("checked  %10d expressions, %zu mismatches\n", BENCH_EXPRESSIONS, mismatches);
+
+  // The timings use a few hot expressions and normal values only, since
+  // subnormal arithmetic is equally slow on both paths
+  for (size_t k = 0; k < 4; ++k)
+    artm_var_set(vars[k], values[0] + (double) k);
+
+  double sum = 0;
+  double start = now();
+  for (int round = 0; round < BENCH_ROUNDS; ++round)
+    for (size_t i = 0; i < BENCH_HOT; ++i)
+      sum += artm_expr_eval(interpreted[i]).as.value;
+  printf("bytecode %10.1f ns/eval\n", (now() - start) / (BENCH_ROUNDS * BENCH_HOT));
+
+  start = now();
+  for (int round = 0; round < BENCH_ROUNDS; ++round)
+    for (size_t i = 0; i < BENCH_HOT; ++i)
+      sum -= artm_expr_eval(native[i]).as.value;
+  printf("native   %10.1f ns/eval\n", (now() - start) / (BENCH_ROUNDS * BENCH_HOT));
+
+  for (size_t i = 0; i < BENCH_EXPRESSIONS; ++i) {
+    artm_expr_free(interpreted[i]);
+    artm_expr_free(native[i]);
+  }
+  artm_calc_free(calc);
+
+  printf("checksum %g\n", sum);
+  return mismatches != 0;
+}
@@ -0,0 +1,120 @@
+/* Number benchmark - Fused number lexing vs. the former strtod path
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arithmo.h"
+#include "lexer.h"
+
+#define BENCH_NUMBERS 200000
+#define BENCH_ROUNDS 10
+#define BENCH_COPY_SIZE 64
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+// The former conversion: the lexer only finds the end of the digits and
+// strtod scans them a second time from a NUL-terminated copy
+static double strtod_number(const char** current, const char* end) {
+  const char* start = *current;
+  while (*current < end && **current >= '0' && **current <= '9')
+    ++*current;
+  if (*current < end && **current == '.') {
+    ++*current;
+    while (*current < end && **current >= '0' && **current <= '9')
+      ++*current;
+  }
+
+  char buffer[BENCH_COPY_SIZE];
+  size_t size = (size_t) (*current - start);
+  memcpy(buffer, start, size);
+  buffer[size] = '\0';
+  return strtod(buffer, NULL);
+}
+
+static double bench_strtod(const char* text, size_t size) {
+  const char* current = text;
+  const char* end = text + size;
+  double sum = 0;
+  while (current < end) {
+    if (*current >= '0' && *current <= '9') {
+      sum += strtod_number(&current, end);
+    } else {
+      ++current;
+    }
+  }
+  return sum;
+}
+
+static double bench_lexer(const char* text, size_t size) {
+  lexer_t lexer;
+  lexer_init(&lexer, text, size);
+
+  double sum = 0;
+  for (token_t token = lexer_next(&lexer); token.type != TKN_END; token = lexer_next(&lexer)) {
+    if (token.type == TKN_NUMBER)
+      sum += token.value;
+  }
+  return sum;
+}
+
+static void report(const char* name, double start, size_t count) {
+  printf("%-8s %10.1f ns/number\n", name, (now() - start) / (double) count);
+}
+
+extern int main(void) {
+  size_t capacity = BENCH_NUMBERS * 32;
+  char* text = (char*) malloc(capacity);
+  if (text == NULL) return 1;
+
+  srand(42);
+  size_t size = 0;
+  for (size_t i = 0; i < BENCH_NUMBERS; ++i) {
+    size += (size_t) snprintf(text + size, capacity - size, "%s%d.%d",
+      i > 0 ? " + " : "", rand() % 100000, rand() % 1000000000);
+  }
+
+  double sum = 0;
+  double start = now();
+  for (int i = 0; i < BENCH_ROUNDS; ++i)
+    sum += bench_strtod(text, size);
+  report("strtod", start, BENCH_NUMBERS * BENCH_ROUNDS);
+
+  start = now();
+  for (int i = 0; i < BENCH_ROUNDS; ++i)
+    sum -= bench_lexer(text, size);
+  report("lexer", start, BENCH_NUMBERS * BENCH_ROUNDS);
+
+  artm_calc_t* calc = artm_calc_init(0);
+  start = now();
+  for (int i = 0; i < BENCH_ROUNDS; ++i)
+    sum += artm_calc_evaln(calc, text, size).as.value;
+  report("eval", start, BENCH_NUMBERS * BENCH_ROUNDS);
+  artm_calc_free(calc);
+
+  printf("checksum %g\n", sum);
+  free(text);
+  return 0;
+}
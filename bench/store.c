@@ -0,0 +1,186 @@
+/* Store benchmark - Readers scaling while a writer updates the variables
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "arithmo.h"
+
+#define BENCH_VARIABLES 10000
+#define BENCH_SIZE 32
+#define BENCH_BATCH 8
+#define BENCH_INSERT_EVERY 1024
+#define BENCH_DURATION_MS 250
+
+typedef enum {
+  MODE_LOCK_FREE,
+  MODE_CONSISTENT,
+  MODE_MUTEX
+} bench_mode_t;
+
+static const char* modes[] = { "lock-free", "consistent", "one mutex" };
+
+typedef struct {
+  artm_calc_t* calc;
+  artm_expr_t* expr;
+  artm_var_t* vars;
+  bench_mode_t mode;
+  pthread_mutex_t lock;
+  atomic_bool stop;
+  atomic_uint_fast64_t reads;
+  atomic_uint_fast64_t writes;
+  atomic_uint_fast64_t torn;
+} bench_t;
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+// x + y is always 0 after a whole batch, so consistent reads never see another value
+static double read_once(bench_t* bench) {
+  switch (bench->mode) {
+    case MODE_CONSISTENT: {
+      double value;
+      size_t version;
+      do {
+        version = artm_calc_read_begin(bench->calc);
+        value = artm_expr_eval(bench->expr).as.value;
+      } while (artm_calc_read_retry(bench->calc, version));
+      return value;
+    }
+    case MODE_MUTEX: {
+      pthread_mutex_lock(&bench->lock);
+      double value = artm_expr_eval(bench->expr).as.value;
+      pthread_mutex_unlock(&bench->lock);
+      return value;
+    }
+    default:
+      return artm_expr_eval(bench->expr).as.value;
+  }
+}
+
+static void* reader(void* payload) {
+  bench_t* bench = (bench_t*) payload;
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  while (!atomic_load_explicit(&bench->stop, memory_order_relaxed)) {
+    torn += read_once(bench) != 0;
+    ++reads;
+  }
+  atomic_fetch_add(&bench->reads, reads);
+  if (bench->mode == MODE_CONSISTENT)
+    atomic_fetch_add(&bench->torn, torn);
+  return NULL;
+}
+
+// Every batch sets x and y to opposite values and a few other variables,
+// and a new variable is declared now and then
+static void* writer(void* payload) {
+  bench_t* bench = (bench_t*) payload;
+  uint64_t writes = 0;
+  size_t inserted = 0;
+  char name[BENCH_SIZE];
+  while (!atomic_load_explicit(&bench->stop, memory_order_relaxed)) {
+    if (bench->mode == MODE_MUTEX)
+      pthread_mutex_lock(&bench->lock);
+    artm_calc_write_begin(bench->calc);
+    double value = (double) (writes % 1000);
+    artm_var_set(bench->vars[0], value);
+    artm_var_set(bench->vars[1], -value);
+    for (size_t i = 2; i < BENCH_BATCH; ++i)
+      artm_var_set(bench->vars[(writes + i * 7919) % BENCH_VARIABLES], value);
+    artm_calc_write_end(bench->calc);
+
+    writes += BENCH_BATCH;
+    if (writes % BENCH_INSERT_EVERY < BENCH_BATCH) {
+      snprintf(name, BENCH_SIZE, "new%zu", inserted++);
+      artm_var_set(artm_calc_var(bench->calc, name), value);
+    }
+    if (bench->mode == MODE_MUTEX)
+      pthread_mutex_unlock(&bench->lock);
+  }
+  atomic_fetch_add(&bench->writes, writes);
+  return NULL;
+}
+
+static void run(bench_mode_t mode, size_t readers) {
+  bench_t bench = { .mode = mode };
+  pthread_mutex_init(&bench.lock, NULL);
+  atomic_init(&bench.stop, false);
+  atomic_init(&bench.reads, 0);
+  atomic_init(&bench.writes, 0);
+  atomic_init(&bench.torn, 0);
+
+  bench.calc = artm_calc_init(BENCH_VARIABLES);
+  bench.vars = (artm_var_t*) malloc(BENCH_VARIABLES * sizeof(artm_var_t));
+  char name[BENCH_SIZE];
+  for (size_t i = 0; i < BENCH_VARIABLES; ++i) {
+    snprintf(name, BENCH_SIZE, i == 0 ? "x" : i == 1 ? "y" : "v%zu", i);
+    bench.vars[i] = artm_calc_var(bench.calc, name);
+    artm_var_set(bench.vars[i], 0);
+  }
+  bench.expr = artm_calc_compile(bench.calc, "x + y", NULL);
+
+  pthread_t threads[readers + 1];
+  for (size_t i = 0; i < readers; ++i)
+    pthread_create(&threads[i], NULL, reader, &bench);
+  pthread_create(&threads[readers], NULL, writer, &bench);
+
+  double start = now();
+  usleep(BENCH_DURATION_MS * 1000);
+  atomic_store(&bench.stop, true);
+  for (size_t i = 0; i <= readers; ++i)
+    pthread_join(threads[i], NULL);
+  double seconds = (now() - start) / 1e3;
+
+  printf("%-10s %7zu %14.1f %14.1f %8llu\n",
+    modes[mode], readers,
+    (double) atomic_load(&bench.reads) / seconds / 1e6,
+    (double) atomic_load(&bench.writes) / seconds / 1e6,
+    (unsigned long long) atomic_load(&bench.torn)
+  );
+
+  artm_expr_free(bench.expr);
+  artm_calc_free(bench.calc);
+  free(bench.vars);
+  pthread_mutex_destroy(&bench.lock);
+}
+
+// The readers go from 1 to the given count (the online CPUs by default),
+// doubling every time
+extern int main(int argc, char** argv) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t max = argc > 1 ? (size_t) strtoul(argv[1], NULL, 10) : (size_t) (cpus > 0 ? cpus : 1);
+  if (max == 0)
+    max = 1;
+
+  printf("%-10s %7s %14s %14s %8s\n", "mode", "readers", "reads (M/s)", "writes (M/s)", "torn");
+  for (int mode = MODE_LOCK_FREE; mode <= MODE_MUTEX; ++mode) {
+    for (size_t readers = 1; readers <= max; readers *= 2)
+      run((bench_mode_t) mode, readers);
+  }
+  return 0;
+}
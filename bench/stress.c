@@ -0,0 +1,175 @@
+/* Stress test - Readers sharing a calc with a writer, checked for torn reads
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "arithmo.h"
+
+#define STRESS_VARIABLES 1000
+#define STRESS_SIZE 32
+#define STRESS_BATCH 8
+#define STRESS_INSERT_EVERY 64
+#define STRESS_MIN_READERS 3
+#define STRESS_DURATION_MS 500
+
+typedef struct {
+  artm_calc_t* calc;
+  artm_expr_t* expr;
+  artm_var_t* vars;
+  atomic_bool stop;
+  atomic_size_t inserted;
+  atomic_uint_fast64_t reads;
+  atomic_uint_fast64_t writes;
+  atomic_uint_fast64_t torn;
+  atomic_uint_fast64_t wrong;
+} stress_t;
+
+// x + y is 0 after every whole batch, through the parser, the cache and
+// the compiled expression alike
+static bool consistent(stress_t* stress) {
+  double parsed, compiled;
+  size_t version;
+  do {
+    version = artm_calc_read_begin(stress->calc);
+    parsed = artm_calc_eval(stress->calc, "x + y").as.value;
+    compiled = artm_expr_eval(stress->expr).as.value;
+  } while (artm_calc_read_retry(stress->calc, version));
+  return parsed == 0 && compiled == 0;
+}
+
+// A variable of the batches holds one of the values written, never a mix of two
+static bool whole(stress_t* stress, size_t index) {
+  double value = artm_var_get(stress->vars[index]);
+  return value >= 0 && value < STRESS_VARIABLES && value == (double) (long) value;
+}
+
+// A variable is counted once its value is set, so it has to be found with it
+static bool published(stress_t* stress, uint64_t seed) {
+  size_t count = atomic_load_explicit(&stress->inserted, memory_order_acquire);
+  if (count == 0)
+    return true;
+
+  char name[STRESS_SIZE];
+  size_t index = (size_t) (seed % count);
+  snprintf(name, STRESS_SIZE, "new%zu", index);
+  artm_result_t result = artm_calc_eval(stress->calc, name);
+  return result.status == ARTM_SUCCESS && result.as.value == (double) index;
+}
+
+static void* reader(void* payload) {
+  stress_t* stress = (stress_t*) payload;
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  uint64_t wrong = 0;
+  while (!atomic_load_explicit(&stress->stop, memory_order_relaxed)) {
+    torn += !consistent(stress) + !whole(stress, 2 + (size_t) (reads * 7919 % (STRESS_VARIABLES - 2)));
+    wrong += !published(stress, reads * 104729);
+    ++reads;
+  }
+  atomic_fetch_add(&stress->reads, reads);
+  atomic_fetch_add(&stress->torn, torn);
+  atomic_fetch_add(&stress->wrong, wrong);
+  return NULL;
+}
+
+// Batches of writes, with a declaration of a new variable now and then
+static void* writer(void* payload) {
+  stress_t* stress = (stress_t*) payload;
+  uint64_t writes = 0;
+  size_t inserted = 0;
+  char text[STRESS_SIZE];
+  while (!atomic_load_explicit(&stress->stop, memory_order_relaxed)) {
+    double value = (double) (writes % STRESS_VARIABLES);
+    artm_calc_write_begin(stress->calc);
+    artm_var_set(stress->vars[0], value);
+    artm_var_set(stress->vars[1], -value);
+    for (size_t i = 2; i < STRESS_BATCH; ++i)
+      artm_var_set(stress->vars[2 + (writes + i * 31) % (STRESS_VARIABLES - 2)], value);
+    artm_calc_write_end(stress->calc);
+
+    writes += STRESS_BATCH;
+    if (writes % STRESS_INSERT_EVERY < STRESS_BATCH) {
+      snprintf(text, STRESS_SIZE, "$new%zu = %zu", inserted, inserted);
+      if (artm_calc_eval(stress->calc, text).status == ARTM_SUCCESS)
+        atomic_store_explicit(&stress->inserted, ++inserted, memory_order_release);
+    }
+  }
+  atomic_fetch_add(&stress->writes, writes);
+  return NULL;
+}
+
+// Runs the given count of readers (the online CPUs by default, and at least
+// a few so that they interleave on any machine) and fails on a torn or wrong
+// read. Built with -fsanitize=thread it reports data races too (the
+// seqlock of the versions has no fences, so ThreadSanitizer follows it)
+extern int main(int argc, char** argv) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t readers = argc > 1 ? (size_t) strtoul(argv[1], NULL, 10) : (size_t) (cpus > 0 ? cpus : 1);
+  if (readers < STRESS_MIN_READERS)
+    readers = STRESS_MIN_READERS;
+
+  stress_t stress = { 0 };
+  atomic_init(&stress.stop, false);
+  atomic_init(&stress.inserted, 0);
+  atomic_init(&stress.reads, 0);
+  atomic_init(&stress.writes, 0);
+  atomic_init(&stress.torn, 0);
+  atomic_init(&stress.wrong, 0);
+
+  stress.calc = artm_calc_init(STRESS_VARIABLES);
+  stress.vars = (artm_var_t*) malloc(STRESS_VARIABLES * sizeof(artm_var_t));
+  char name[STRESS_SIZE];
+  for (size_t i = 0; i < STRESS_VARIABLES; ++i) {
+    snprintf(name, STRESS_SIZE, i == 0 ? "x" : i == 1 ? "y" : "v%zu", i);
+    stress.vars[i] = artm_calc_var(stress.calc, name);
+    artm_var_set(stress.vars[i], 0);
+  }
+  stress.expr = artm_calc_compile(stress.calc, "x + y", NULL);
+
+  pthread_t threads[readers + 1];
+  for (size_t i = 0; i < readers; ++i)
+    pthread_create(&threads[i], NULL, reader, &stress);
+  pthread_create(&threads[readers], NULL, writer, &stress);
+
+  usleep(STRESS_DURATION_MS * 1000);
+  atomic_store(&stress.stop, true);
+  for (size_t i = 0; i <= readers; ++i)
+    pthread_join(threads[i], NULL);
+
+  uint64_t torn = atomic_load(&stress.torn);
+  uint64_t wrong = atomic_load(&stress.wrong);
+  printf("%zu readers: %llu reads, %llu writes, %zu declarations, %llu torn, %llu wrong\n",
+    readers,
+    (unsigned long long) atomic_load(&stress.reads),
+    (unsigned long long) atomic_load(&stress.writes),
+    atomic_load(&stress.inserted),
+    (unsigned long long) torn,
+    (unsigned long long) wrong
+  );
+
+  artm_expr_free(stress.expr);
+  artm_calc_free(stress.calc);
+  free(stress.vars);
+  return torn == 0 && wrong == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,372 @@
+/* Bench - Reproducible workloads for the whole library
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+
+#include "arithmo.h"
+
+#define BENCH_REPEATS 5
+#define BENCH_TEXTS 4096
+#define BENCH_TEXT_SIZE 256
+#define BENCH_NESTING 64
+#define BENCH_LITERALS 16
+#define BENCH_DECL_VARS 256
+#define BENCH_MAX_RESULTS 32
+
+typedef struct bench bench_t;
+typedef struct texts texts_t;
+typedef struct report report_t;
+typedef double (*bench_run_t)(void* payload, size_t count);
+
+struct report {
+  const char* name;
+  size_t evals;
+  size_t cache;
+  double ns_per_eval;
+  double allocs_per_eval;
+  long peak_rss_kb;
+};
+
+struct bench {
+  double scale;
+  report_t reports[BENCH_MAX_RESULTS];
+  size_t count;
+};
+
+struct texts {
+  artm_calc_t* calc;
+  const char* data[BENCH_TEXTS];
+  size_t count;
+};
+
+static void bench_short(bench_t* bench);
+static void bench_nested(bench_t* bench);
+static void bench_vars(bench_t* bench);
+static void bench_decls(bench_t* bench);
+static void bench_literals(bench_t* bench);
+static void print_text(const bench_t* bench, FILE* stream);
+static void print_json(const bench_t* bench, FILE* stream);
+
+// Counting allocator, so that the allocations of every workload can be
+// reported (glibc lets programs replace malloc and exports the originals)
+#ifdef __GLIBC__
+
+#define BENCH_ALLOCS 1
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* pointer);
+
+static atomic_size_t allocations;
+
+extern void* malloc(size_t size) {
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern void* calloc(size_t count, size_t size) {
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+extern void* realloc(void* pointer, size_t size) {
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  return __libc_realloc(pointer, size);
+}
+
+extern void* aligned_alloc(size_t alignment, size_t size) {
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+
+extern void free(void* pointer) {
+  __libc_free(pointer);
+}
+
+static inline size_t allocs(void) {
+  return atomic_load_explicit(&allocations, memory_order_relaxed);
+}
+
+#else
+
+#define BENCH_ALLOCS 0
+
+static inline size_t allocs(void) {
+  return 0;
+}
+
+#endif
+
+// splitmix64, so that the workloads are the same with every libc
+static uint64_t seed = 42;
+
+static uint64_t next_random(void) {
+  uint64_t z = (seed += UINT64_C(0x9E3779B97F4A7C15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+  return z ^ (z >> 31);
+}
+
+static inline size_t random_below(size_t bound) {
+  return (size_t) (next_random() % bound);
+}
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static long peak_rss(void) {
+  struct rusage usage;
+  return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+}
+
+static artm_calc_t* make_calc(size_t decls, size_t cache) {
+  artm_config_t config = { .decl_table_size = decls, .cache_capacity = cache };
+  return artm_calc_init_ex(&config);
+}
+
+static double run_texts(void* payload, size_t count) {
+  texts_t* texts = (texts_t*) payload;
+  double sum = 0;
+  for (size_t i = 0; i < count; ++i)
+    sum += artm_calc_eval(texts->calc, texts->data[i % texts->count]).as.value;
+  return sum;
+}
+
+static double run_compiled(void* payload, size_t count) {
+  const artm_expr_t* expr = (const artm_expr_t*) payload;
+  double sum = 0;
+  for (size_t i = 0; i < count; ++i)
+    sum += artm_expr_eval(expr).as.value;
+  return sum;
+}
+
+static volatile double sink;
+
+// The best of a few repetitions after a warm-up pass
+static void measure(bench_t* bench, const char* name, size_t cache, size_t evals, bench_run_t run, void* payload) {
+  evals = (size_t) ((double) evals * bench->scale);
+  if (evals == 0) evals = 1;
+
+  sink = run(payload, evals);
+
+  double best = 0;
+  size_t before = allocs();
+  for (int i = 0; i < BENCH_REPEATS; ++i) {
+    double start = now();
+    sink = run(payload, evals);
+    double elapsed = now() - start;
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  if (bench->count < BENCH_MAX_RESULTS) {
+    bench->reports[bench->count++] = (report_t) {
+      .name = name,
+      .evals = evals,
+      .cache = cache,
+      .ns_per_eval = best / (double) evals,
+      .allocs_per_eval = (double) (allocs() - before) / (double) (evals * BENCH_REPEATS),
+      .peak_rss_kb = peak_rss()
+    };
+  }
+}
+
+static void measure_texts(bench_t* bench, const char* name, texts_t* texts, size_t cache, size_t evals) {
+  measure(bench, name, cache, evals, run_texts, texts);
+}
+
+extern int main(int argc, char** argv) {
+  bench_t bench = { .scale = 1 };
+  bool json = false;
+  const char* output = NULL;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      bench.scale = 0.05;
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--json] [--quick] [--output FILE]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  bench_short(&bench);
+  bench_nested(&bench);
+  bench_vars(&bench);
+  bench_decls(&bench);
+  bench_literals(&bench);
+
+  FILE* stream = output != NULL ? fopen(output, "w") : stdout;
+  if (stream == NULL) {
+    perror(output);
+    return 1;
+  }
+
+  if (json) print_json(&bench, stream);
+  else print_text(&bench, stream);
+
+  if (stream != stdout)
+    fclose(stream);
+  return 0;
+}
+
+static void bench_short(bench_t* bench) {
+  static texts_t texts = { .data = { "1 + 2 * x", "x * x - 3", "(x + 1) / 2.5", "-x + 4" }, .count = 4 };
+
+  texts.calc = make_calc(4, 64);
+  artm_var_set(artm_calc_var(texts.calc, "x"), 3);
+  measure_texts(bench, "short", &texts, 64, 2000000);
+  artm_calc_free(texts.calc);
+
+  texts.calc = make_calc(4, 0);
+  artm_var_set(artm_calc_var(texts.calc, "x"), 3);
+  measure_texts(bench, "short_uncached", &texts, 0, 2000000);
+
+  artm_expr_t* expr = artm_calc_compile(texts.calc, texts.data[0], NULL);
+  measure(bench, "short_compiled", 0, 10000000, run_compiled, expr);
+  artm_expr_free(expr);
+  artm_calc_free(texts.calc);
+}
+
+// ((((x + 1) - 2) * 3) / 4 ...) nested BENCH_NESTING levels deep
+static void bench_nested(bench_t* bench) {
+  static char data[BENCH_NESTING * 8];
+  size_t size = 0;
+  for (size_t i = 0; i < BENCH_NESTING; ++i)
+    data[size++] = '(';
+  data[size++] = 'x';
+  for (size_t i = 0; i < BENCH_NESTING; ++i)
+    size += (size_t) sprintf(data + size, " %c %zu)", "+-*/"[i % 4], i % 9 + 1);
+
+  static texts_t texts = { .count = 1 };
+  texts.calc = make_calc(4, 0);
+  texts.data[0] = data;
+  artm_var_set(artm_calc_var(texts.calc, "x"), 1.5);
+  measure_texts(bench, "nested", &texts, 0, 200000);
+
+  artm_expr_t* expr = artm_calc_compile(texts.calc, data, NULL);
+  measure(bench, "nested_compiled", 0, 2000000, run_compiled, expr);
+  artm_expr_free(expr);
+  artm_calc_free(texts.calc);
+}
+
+// Random three-variable expressions over tables of 10 to 1M variables
+static void bench_vars(bench_t* bench) {
+  static const struct { const char* name; size_t count; } tables[] = {
+    { "vars_10", 10 },
+    { "vars_1k", 1000 },
+    { "vars_100k", 100000 },
+    { "vars_1m", 1000000 }
+  };
+
+  static char data[BENCH_TEXTS][BENCH_TEXT_SIZE];
+  char name[BENCH_TEXT_SIZE];
+
+  for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); ++t) {
+    size_t count = tables[t].count;
+    static texts_t texts = { .count = BENCH_TEXTS };
+    texts.calc = make_calc(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+      snprintf(name, sizeof(name), "var_%zu", i);
+      artm_var_set(artm_calc_var(texts.calc, name), (double) i);
+    }
+
+    for (size_t i = 0; i < BENCH_TEXTS; ++i) {
+      snprintf(data[i], BENCH_TEXT_SIZE, "var_%zu + var_%zu * var_%zu",
+        random_below(count), random_below(count), random_below(count));
+      texts.data[i] = data[i];
+    }
+
+    measure_texts(bench, tables[t].name, &texts, 0, 1000000);
+    artm_calc_free(texts.calc);
+  }
+}
+
+// Declarations of a few hundred variables over and over, through parse_decl
+static void bench_decls(bench_t* bench) {
+  static char data[BENCH_TEXTS][BENCH_TEXT_SIZE];
+  static texts_t texts = { .count = BENCH_TEXTS };
+  for (size_t i = 0; i < BENCH_TEXTS; ++i) {
+    snprintf(data[i], BENCH_TEXT_SIZE, "$decl_%zu = %zu.5 * 2",
+      random_below(BENCH_DECL_VARS), random_below(1000));
+    texts.data[i] = data[i];
+  }
+
+  texts.calc = make_calc(BENCH_DECL_VARS, 0);
+  measure_texts(bench, "decl_churn", &texts, 0, 1000000);
+  artm_calc_free(texts.calc);
+}
+
+// Sums of BENCH_LITERALS decimal literals with fractions and exponents
+static void bench_literals(bench_t* bench) {
+  static char data[BENCH_TEXTS][BENCH_TEXT_SIZE];
+  static texts_t texts = { .count = BENCH_TEXTS };
+  for (size_t i = 0; i < BENCH_TEXTS; ++i) {
+    size_t size = 0;
+    for (size_t j = 0; j < BENCH_LITERALS; ++j) {
+      size += (size_t) snprintf(data[i] + size, BENCH_TEXT_SIZE - size, "%s%zu.%04zue%zu",
+        j > 0 ? " + " : "", random_below(100000), random_below(10000), random_below(20));
+    }
+    texts.data[i] = data[i];
+  }
+
+  texts.calc = make_calc(0, 0);
+  measure_texts(bench, "literals", &texts, 0, 500000);
+  artm_calc_free(texts.calc);
+}
+
+static void print_text(const bench_t* bench, FILE* stream) {
+  fprintf(stream, "%-16s %10s %12s %14s %12s %12s\n",
+    "workload", "evals", "ns/eval", "evals/sec", "allocs/eval", "peak rss kb");
+  for (size_t i = 0; i < bench->count; ++i) {
+    const report_t* report = &bench->reports[i];
+    fprintf(stream, "%-16s %10zu %12.1f %14.0f %12.2f %12ld\n",
+      report->name, report->evals, report->ns_per_eval, 1e9 / report->ns_per_eval,
+      report->allocs_per_eval, report->peak_rss_kb);
+  }
+}
+
+static void print_json(const bench_t* bench, FILE* stream) {
+  fprintf(stream, "{\n  \"version\": \"%s\",\n  \"allocs_counted\": %s,\n  \"workloads\": [\n",
+    ARITHMO_VERSION, BENCH_ALLOCS ? "true" : "false");
+  for (size_t i = 0; i < bench->count; ++i) {
+    const report_t* report = &bench->reports[i];
+    fprintf(stream,
+      "    {\"name\": \"%s\", \"evals\": %zu, \"cache_capacity\": %zu, \"ns_per_eval\": %.3f, "
+      "\"evals_per_sec\": %.0f, \"allocs_per_eval\": %.3f, \"peak_rss_kb\": %ld}%s\n",
+      report->name, report->evals, report->cache, report->ns_per_eval, 1e9 / report->ns_per_eval,
+      report->allocs_per_eval, report->peak_rss_kb, i + 1 < bench->count ? "," : "");
+  }
+  fprintf(stream, "  ]\n}\n");
+}
@@ -0,0 +1,174 @@
+/* Table benchmark - Open addressing vs. the former chained hash table
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloc.h"
+#include "table.h"
+
+#define BENCH_KEY_SIZE 32
+
+typedef struct chain chain_t;
+typedef struct chain_item chain_item_t;
+
+// The chained hash table used before the open addressing one (byte-sum hash,
+// fixed bucket count, one node and one key copy per put, no replacement)
+struct chain {
+  size_t size;
+  chain_item_t** items;
+};
+
+struct chain_item {
+  char* key;
+  double data;
+  chain_item_t* next;
+};
+
+static void chain_init(chain_t* chain, size_t size) {
+  chain->size = size;
+  chain->items = (chain_item_t**) calloc(size, sizeof(chain_item_t*));
+}
+
+static void chain_free(chain_t* chain) {
+  for (size_t i = 0; i < chain->size; ++i) {
+    chain_item_t* current = chain->items[i];
+    while (current != NULL) {
+      chain_item_t* next = current->next;
+      free(current->key);
+      free(current);
+      current = next;
+    }
+  }
+  free(chain->items);
+}
+
+static size_t chain_hash(const char* str, size_t size) {
+  size_t result = 0;
+  while (*str != '\0')
+    result += (size_t) *(str++);
+  return result % size;
+}
+
+static const double* chain_get(const chain_t* chain, const char* key) {
+  chain_item_t* current = chain->items[chain_hash(key, chain->size)];
+  while (current != NULL) {
+    if (strcmp(current->key, key) == 0)
+      return &current->data;
+    current = current->next;
+  }
+  return NULL;
+}
+
+static void chain_put(chain_t* chain, const char* key, double value) {
+  size_t index = chain_hash(key, chain->size);
+  chain_item_t* node = (chain_item_t*) malloc(sizeof(chain_item_t));
+  if (node == NULL) return;
+
+  node->key = strdup(key);
+  node->data = value;
+  node->next = chain->items[index];
+  chain->items[index] = node;
+}
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static void report(const char* impl, const char* op, size_t count, double start) {
+  printf("%-8s %-10s %10zu keys %10.1f ns/op\n", impl, op, count, (now() - start) / (double) count);
+}
+
+static void bench_chain(char (*keys)[BENCH_KEY_SIZE], size_t count, size_t buckets) {
+  chain_t chain;
+  chain_init(&chain, buckets);
+
+  char impl[32];
+  snprintf(impl, sizeof(impl), "chain/%zu", buckets);
+
+  double start = now();
+  for (size_t i = 0; i < count; ++i)
+    chain_put(&chain, keys[i], (double) i);
+  report(impl, "insert", count, start);
+
+  double sum = 0;
+  start = now();
+  for (size_t i = 0; i < count; ++i)
+    sum += *chain_get(&chain, keys[i]);
+  report(impl, "lookup", count, start);
+
+  start = now();
+  for (size_t i = 0; i < count; ++i)
+    chain_put(&chain, keys[i], (double) i);
+  report(impl, "redeclare", count, start);
+
+  chain_free(&chain);
+  if (sum < 0) printf("%g\n", sum);
+}
+
+static void bench_table(char (*keys)[BENCH_KEY_SIZE], size_t count) {
+  table_t table;
+  table_init(&table, 0, &alloc_default);
+
+  double start = now();
+  for (size_t i = 0; i < count; ++i)
+    table_put(&table, keys[i], strlen(keys[i]), TABLE_DBL_VALUE((double) i));
+  report("table", "insert", count, start);
+
+  double sum = 0;
+  start = now();
+  for (size_t i = 0; i < count; ++i)
+    sum += table_get(&table, keys[i], strlen(keys[i])).as.dbl;
+  report("table", "lookup", count, start);
+
+  start = now();
+  for (size_t i = 0; i < count; ++i)
+    table_put(&table, keys[i], strlen(keys[i]), TABLE_DBL_VALUE((double) i));
+  report("table", "redeclare", count, start);
+
+  start = now();
+  for (size_t i = 0; i < count; ++i)
+    table_remove(&table, keys[i], strlen(keys[i]));
+  report("table", "remove", count, start);
+
+  table_free(&table);
+  if (sum < 0) printf("%g\n", sum);
+}
+
+extern int main(int argc, char** argv) {
+  size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+
+  char (*keys)[BENCH_KEY_SIZE] = malloc(count * BENCH_KEY_SIZE);
+  if (keys == NULL) return 1;
+
+  srand(42);
+  for (size_t i = 0; i < count; ++i)
+    snprintf(keys[i], BENCH_KEY_SIZE, "v%zx_%x", i, rand() & 0xfff);
+
+  bench_chain(keys, count, count);
+  bench_chain(keys, count, 1024);
+  bench_table(keys, count);
+
+  free(keys);
+  return 0;
+}
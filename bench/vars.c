@@ -0,0 +1,117 @@
+/* Variables benchmark - Bulk loads and snapshots against declarations
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arithmo.h"
+
+#define BENCH_VARIABLES 1000000
+#define BENCH_SIZE 48
+#define BENCH_ROUNDS 5
+#define BENCH_PATH "vars_bench.bin"
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+static double keep(double time, double best, int round) {
+  return round == 0 || time < best ? time : best;
+}
+
+// Every variable has to read back exactly what was assigned
+static size_t mismatches(artm_calc_t* calc, char (*names)[BENCH_SIZE], const double* values) {
+  size_t count = 0;
+  for (size_t i = 0; i < BENCH_VARIABLES; ++i) {
+    double value = artm_var_get(artm_calc_var(calc, names[i]));
+    if (memcmp(&value, &values[i], sizeof(double)) != 0)
+      ++count;
+  }
+  return count;
+}
+
+// Each round starts from a fresh calc, so the table grows from empty every time
+extern int main(void) {
+  static char names[BENCH_VARIABLES][BENCH_SIZE];
+  static char decls[BENCH_VARIABLES][BENCH_SIZE];
+  static const char* pointers[BENCH_VARIABLES];
+  static double values[BENCH_VARIABLES];
+
+  srand(42);
+  for (size_t i = 0; i < BENCH_VARIABLES; ++i) {
+    values[i] = (double) rand() / 64;
+    snprintf(names[i], BENCH_SIZE, "v%zu", i);
+    snprintf(decls[i], BENCH_SIZE, "$v%zu = %.17g", i, values[i]);
+    pointers[i] = names[i];
+  }
+
+  size_t wrong = 0;
+  double best = 0;
+  for (int round = 0; round < BENCH_ROUNDS; ++round) {
+    artm_calc_t* calc = artm_calc_init(0);
+    double start = now();
+    for (size_t i = 0; i < BENCH_VARIABLES; ++i)
+      artm_calc_eval(calc, decls[i]);
+    best = keep(now() - start, best, round);
+    if (round == 0)
+      wrong += mismatches(calc, names, values);
+    artm_calc_free(calc);
+  }
+  printf("declarations %10.1f ms\n", best);
+
+  artm_status_t status = ARTM_SUCCESS;
+  for (int round = 0; status == ARTM_SUCCESS && round < BENCH_ROUNDS; ++round) {
+    artm_calc_t* calc = artm_calc_init(0);
+    double start = now();
+    status = artm_calc_set_vars(calc, pointers, values, BENCH_VARIABLES);
+    best = keep(now() - start, best, round);
+    if (round == 0)
+      wrong += mismatches(calc, names, values);
+    artm_calc_free(calc);
+  }
+  printf("set_vars     %10.1f ms\n", best);
+
+  artm_calc_t* source = artm_calc_init(0);
+  if (status == ARTM_SUCCESS)
+    status = artm_calc_set_vars(source, pointers, values, BENCH_VARIABLES);
+  double start = now();
+  if (status == ARTM_SUCCESS)
+    status = artm_calc_snapshot(source, BENCH_PATH);
+  printf("snapshot     %10.1f ms\n", now() - start);
+  artm_calc_free(source);
+
+  for (int round = 0; status == ARTM_SUCCESS && round < BENCH_ROUNDS; ++round) {
+    artm_calc_t* calc = artm_calc_init(0);
+    start = now();
+    status = artm_calc_restore(calc, BENCH_PATH);
+    best = keep(now() - start, best, round);
+    if (round == 0)
+      wrong += mismatches(calc, names, values);
+    artm_calc_free(calc);
+  }
+  printf("restore      %10.1f ms\n", best);
+  remove(BENCH_PATH);
+
+  printf("checked %10d variables, %zu mismatches\n", BENCH_VARIABLES, wrong);
+  return status != ARTM_SUCCESS || wrong != 0;
+}
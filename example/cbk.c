@@ -27,12 +27,33 @@ static void error_cbk(const artm_result_t* result, __attribute_maybe_unused__ vo
     case ARTM_ALLOC_ERR:
       printf("[ERROR] ALLOC_ERR\n");
       break;
+    case ARTM_IO_ERR:
+      printf("[ERROR] IO_ERR\n");
+      break;
     case ARTM_INV_TOKEN:
       printf("[ERROR] INV_TOKEN -> '%.*s'\n", (int) token->size, token->target);
       break;
     case ARTM_UNDEF_VAR:
       printf("[ERROR] UNDEF_VAR -> '%.*s'\n", (int) token->size, token->target);
       break;
+    case ARTM_READ_ONLY:
+      printf("[ERROR] READ_ONLY -> '%.*s'\n", (int) token->size, token->target);
+      break;
+    case ARTM_CONST_VAR:
+      printf("[ERROR] CONST_VAR -> '%.*s'\n", (int) token->size, token->target);
+      break;
+    case ARTM_CYCLE:
+      printf("[ERROR] CYCLE -> '%.*s'\n", (int) token->size, token->target);
+      break;
+    case ARTM_UNDEF_FN:
+      printf("[ERROR] UNDEF_FN -> '%.*s'\n", (int) token->size, token->target);
+      break;
+    case ARTM_TOO_DEEP:
+      printf("[ERROR] TOO_DEEP -> '%.*s'\n", (int) token->size, token->target);
+      break;
+    case ARTM_BAD_FORMAT:
+      printf("[ERROR] BAD_FORMAT\n");
+      break;
     default: break;
   }
 }
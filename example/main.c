@@ -27,10 +27,24 @@ static int eval(artm_calc_t* calc, const char* expression) {
       return printf("[ERROR] NULL_EXPR\n");
     case ARTM_ALLOC_ERR:
       return printf("[ERROR] ALLOC_ERR\n");
+    case ARTM_IO_ERR:
+      return printf("[ERROR] IO_ERR\n");
     case ARTM_INV_TOKEN:
       return printf("[ERROR] INV_TOKEN -> '%.*s'\n", (int) token->size, token->target);
     case ARTM_UNDEF_VAR:
       return printf("[ERROR] UNDEF_VAR -> '%.*s'\n", (int) token->size, token->target);
+    case ARTM_READ_ONLY:
+      return printf("[ERROR] READ_ONLY -> '%.*s'\n", (int) token->size, token->target);
+    case ARTM_CONST_VAR:
+      return printf("[ERROR] CONST_VAR -> '%.*s'\n", (int) token->size, token->target);
+    case ARTM_CYCLE:
+      return printf("[ERROR] CYCLE -> '%.*s'\n", (int) token->size, token->target);
+    case ARTM_UNDEF_FN:
+      return printf("[ERROR] UNDEF_FN -> '%.*s'\n", (int) token->size, token->target);
+    case ARTM_TOO_DEEP:
+      return printf("[ERROR] TOO_DEEP -> '%.*s'\n", (int) token->size, token->target);
+    case ARTM_BAD_FORMAT:
+      return printf("[ERROR] BAD_FORMAT\n");
     default:
       return printf("[SUCCESS] %s = %g\n", expression, result.as.value);
   }
@@ -21,14 +21,89 @@
 #define ARITHMO_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Thread safety:
+ * - An artm_calc_t holds only shared state (the declared variables) and an
+ *   artm_expr_t only its immutable program; the per-call evaluation state
+ *   lives on the calling thread's stack.
+ * - Readers may run concurrently on the same calc and the same expressions:
+ *   artm_calc_eval/artm_calc_cbk_eval of expressions that are not declarations,
+ *   artm_eval_many (calls on the same calc share one thread pool in turn),
+ *   artm_expr_eval, artm_expr_cbk_eval, artm_expr_eval_batch, artm_expr_eval_grad,
+ *   artm_expr_eval_tangents and artm_calc_eval_grad of expressions
+ *   that are not declarations, artm_calc_eval_script and artm_script_eval of
+ *   scripts without declarations, artm_calc_fork, artm_exprset_eval, artm_expr_save, artm_calc_snapshot
+ *   and artm_var_get.
+ * - Variable writers run one at a time, but the readers never wait for them:
+ *   declarations of values ("$x = ..."), artm_calc_var, artm_var_set,
+ *   artm_calc_set_vars, artm_calc_write_begin and artm_calc_write_end, as long
+ *   as no formula reads the written variables. A reader sees each variable
+ *   either before or after a write; the reads between artm_calc_read_begin and
+ *   a false artm_calc_read_retry see the batches of writes all at once.
+ * - Writers need exclusive access to the calc: declarations of formulas, artm_calc_compile,
+ *   artm_calc_compile_ex, artm_calc_compile_set, artm_exprset_free, artm_calc_compile_script,
+ *   artm_script_free, artm_expr_load, artm_calc_const, artm_calc_restore,
+ *   artm_calc_register_fn, artm_calc_register_vec_fn,
+ *   artm_calc_refresh, artm_calc_stats_hook, artm_expr_free and artm_calc_free.
+ * - Reading a formula ("$x := ...") whose inputs changed recomputes it, so
+ *   call artm_calc_refresh after the writes before reading from many threads.
+ * - Forks of the same calc can be used from different threads, as long as
+ *   nothing writes to the parent meanwhile.
+ */
 
 #define ARTM_CBK(_target_, _payload_) \
   ((artm_cbk_t) { .target = (_target_), .payload = (_payload_) })
 
+#define ARTM_STREAM_CBK(_target_, _payload_) \
+  ((artm_stream_cbk_t) { .target = (_target_), .payload = (_payload_) })
+
+#define ARTM_STATS_HOOK(_target_, _payload_, _interval_) \
+  ((artm_stats_hook_t) { .target = (_target_), .payload = (_payload_), .interval = (_interval_) })
+
+#define ARTM_ALLOCATOR(_allocate_, _reallocate_, _release_, _payload_) \
+  ((artm_allocator_t) { \
+    .allocate = (_allocate_), .reallocate = (_reallocate_), .release = (_release_), .payload = (_payload_) \
+  })
+
+// The number of artm_status_t values (keep it in sync with the enum)
+#define ARTM_STATUS_COUNT (ARTM_BAD_FORMAT + 1)
+
+// The number of power-of-two latency buckets in artm_stats_t
+#define ARTM_STATS_BUCKETS 32
+
+// The nesting an expression can have when artm_config_t leaves max_depth at 0
+#define ARTM_DEFAULT_MAX_DEPTH 4096
+
+// The most arguments a registered function can take
+#define ARTM_FN_MAX_ARITY 8
+
 typedef struct artm_calc artm_calc_t;
+typedef struct artm_expr artm_expr_t;
+typedef struct artm_exprset artm_exprset_t;
+typedef struct artm_script artm_script_t;
+typedef struct artm_var* artm_var_t;
 typedef struct artm_result artm_result_t;
 typedef struct artm_token artm_token_t;
 typedef struct artm_cbk artm_cbk_t;
+typedef struct artm_stream_cbk artm_stream_cbk_t;
+typedef struct artm_column artm_column_t;
+typedef struct artm_config artm_config_t;
+typedef struct artm_allocator artm_allocator_t;
+typedef struct artm_cache_stats artm_cache_stats_t;
+typedef struct artm_stats artm_stats_t;
+typedef struct artm_stats_hook artm_stats_hook_t;
+typedef struct artm_exprset_stats artm_exprset_stats_t;
+
+// A function called with its arguments in order (args[0] is the first one)
+typedef double (*artm_fn_t)(const double* args);
+
+// The same function over count rows: args[i] points to the count values of argument i
+// (results never overlaps them)
+typedef void (*artm_vec_fn_t)(double* results, const double* const* args, size_t count);
 
 typedef enum {
   ARTM_SUCCESS,
@@ -36,9 +111,29 @@ typedef enum {
   ARTM_NULL_EXPR,
   ARTM_INV_TOKEN,
   ARTM_ALLOC_ERR,
-  ARTM_UNDEF_VAR
+  ARTM_UNDEF_VAR,
+  ARTM_READ_ONLY,
+  ARTM_IO_ERR,
+  ARTM_CONST_VAR,
+  ARTM_CYCLE,
+  ARTM_UNDEF_FN,
+  ARTM_TOO_DEEP,
+  ARTM_BAD_FORMAT
 } artm_status_t;
 
+typedef enum {
+  ARTM_OPT_NONE = 0,
+  ARTM_OPT_FOLD = 1 << 0,
+  ARTM_OPT_FAST_MATH = 1 << 1,
+  ARTM_OPT_JIT = 1 << 2,
+  ARTM_OPT_DEFAULT = ARTM_OPT_FOLD
+} artm_opt_t;
+
+typedef enum {
+  ARTM_FN_DEFAULT = 0,
+  ARTM_FN_PURE = 1 << 0
+} artm_fn_flags_t;
+
 struct artm_token {
   size_t size;
   const char* target;
@@ -57,6 +152,66 @@ struct artm_cbk {
   void* payload;
 };
 
+struct artm_stream_cbk {
+  void (*target)(const artm_token_t*, const artm_result_t*, void*);
+  void* payload;
+};
+
+struct artm_column {
+  artm_var_t var;
+  const double* data;
+};
+
+// The same contract as malloc, realloc and free, with the payload passed along
+struct artm_allocator {
+  void* (*allocate)(size_t size, void* payload);
+  void* (*reallocate)(void* pointer, size_t size, void* payload);
+  void (*release)(void* pointer, void* payload);
+  void* payload;
+};
+
+struct artm_config {
+  size_t decl_table_size;
+  size_t cache_capacity;
+  size_t max_depth;
+  bool stats_latency;
+  artm_allocator_t allocator;
+};
+
+struct artm_cache_stats {
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+  size_t size;
+  size_t capacity;
+};
+
+struct artm_stats {
+  bool enabled;
+  uint64_t evaluations;
+  uint64_t tokens;
+  uint64_t lookups;
+  uint64_t probes;
+  uint64_t max_probes;
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+  uint64_t errors[ARTM_STATUS_COUNT];
+  uint64_t latency[ARTM_STATS_BUCKETS];
+};
+
+struct artm_exprset_stats {
+  size_t formulas;
+  size_t nodes;
+  size_t unique_nodes;
+  size_t shared_nodes;
+};
+
+struct artm_stats_hook {
+  void (*target)(const artm_stats_t*, void*);
+  void* payload;
+  uint64_t interval;
+};
+
 /**
  * @brief Initializes an Arithmo Interpreter object
  * @param decl_table_size The approximate number of variables that will be used
@@ -64,6 +219,60 @@ struct artm_cbk {
  */
 extern artm_calc_t* artm_calc_init(size_t decl_table_size);
 
+/**
+ * @brief Initializes an Arithmo Interpreter object with an explicit configuration
+ * @param config The configuration (cache_capacity is the number of evaluated expressions
+ *               whose compiled programs are kept for repeated texts, which are compiled the
+ *               second time they are evaluated, 0 disables the cache;
+ *               max_depth bounds the operators an expression can leave pending while it
+ *               nests (parentheses, signs, calls), deeper ones give ARTM_TOO_DEEP and
+ *               0 means ARTM_DEFAULT_MAX_DEPTH;
+ *               stats_latency fills the latency histogram of artm_calc_stats;
+ *               allocator provides all the memory of the calc and of its expressions,
+ *               formula sets and calls (all three callbacks NULL means malloc); the
+ *               callbacks must be thread-safe if the calc is read from many threads.
+ *               The variables and registered functions are carved out of large chunks
+ *               that are only released by artm_calc_free)
+ * @return The Arithmo Interpreter object, or NULL if only some of the callbacks are set
+ */
+extern artm_calc_t* artm_calc_init_ex(const artm_config_t* config);
+
+/**
+ * @brief Creates a child calc in constant time: the names it doesn't declare are read from
+ *        the parent, and everything written to it (variables, constants, formulas, functions)
+ *        stays in the child
+ * @param parent The calc to read through to (it must outlive the fork, must not be written
+ *               while the fork is used, and its formulas are read with its own values,
+ *               so call artm_calc_refresh on it first)
+ * @return The child calc, which has the settings of the parent (free it with artm_calc_free),
+ *         or NULL in case of an error
+ */
+extern artm_calc_t* artm_calc_fork(artm_calc_t* parent);
+
+/**
+ * @brief Reads the counters of the expression cache used by the evaluation functions
+ * @param calc An Arithmo Interpreter object
+ * @param stats Where to store the counters
+ * @return Void
+ */
+extern void artm_calc_cache_stats(artm_calc_t* calc, artm_cache_stats_t* stats);
+
+/**
+ * @brief Reads the runtime counters of a calc (all zero and not enabled unless built with ARITHMO_STATS)
+ * @param calc An Arithmo Interpreter object
+ * @param stats Where to store the counters (latency[i] counts evaluations of [2^i, 2^(i+1)) ns)
+ * @return The status of the operation
+ */
+extern artm_status_t artm_calc_stats(artm_calc_t* calc, artm_stats_t* stats);
+
+/**
+ * @brief Sets a callback that receives the counters every interval evaluations (ignored unless built with ARITHMO_STATS)
+ * @param calc An Arithmo Interpreter object
+ * @param hook The callback (runs on the evaluating thread, a NULL target removes it)
+ * @return The status of the operation
+ */
+extern artm_status_t artm_calc_stats_hook(artm_calc_t* calc, artm_stats_hook_t hook);
+
 /**
  * @brief Deallocates the memory previously allocated by a call to artm_calc_init
  * @param calc An Arithmo Interpreter object
@@ -79,6 +288,26 @@ extern void artm_calc_free(artm_calc_t* calc);
  */
 extern artm_result_t artm_calc_eval(artm_calc_t* calc, const char* expression);
 
+/**
+ * @brief Evaluates the given mathematical expression of a known length (no NUL terminator needed)
+ * @param calc An Arithmo Interpreter object
+ * @param expression The mathematical expression
+ * @param size The length of the expression in bytes
+ * @return The evaluation result structure
+ */
+extern artm_result_t artm_calc_evaln(artm_calc_t* calc, const char* expression, size_t size);
+
+/**
+ * @brief Evaluates a script of statements separated by ';' or new lines in a single pass
+ * @param calc An Arithmo Interpreter object
+ * @param script The statements (empty ones are skipped)
+ * @param results Where to store the result of each statement, in order (may be NULL)
+ * @param count The capacity of results on input, the number of statements run on output (may be NULL)
+ * @return The result of the last statement, or of the first one that fails (whose token
+ *         points into the script); the statements after it are not run
+ */
+extern artm_result_t artm_calc_eval_script(artm_calc_t* calc, const char* script, artm_result_t* results, size_t* count);
+
 /**
  * @brief Evaluates the given mathematical expression
  * @param calc An Arithmo Interpreter object
@@ -88,4 +317,367 @@ extern artm_result_t artm_calc_eval(artm_calc_t* calc, const char* expression);
  */
 extern double artm_calc_cbk_eval(artm_calc_t* calc, const char* expression, artm_cbk_t cbk);
 
+/**
+ * @brief Evaluates the newline or ';' separated expressions read from a file descriptor
+ * @param calc An Arithmo Interpreter object
+ * @param fd The file descriptor (regular files are mapped in place, anything else is read in chunks)
+ * @param cbk The callback that is called with every expression and its result (valid only during the call,
+ *            ARTM_NULL_EXPR without one)
+ * @return The status of the whole operation
+ */
+extern artm_status_t artm_calc_eval_fd(artm_calc_t* calc, int fd, artm_stream_cbk_t cbk);
+
+/**
+ * @brief Evaluates the newline or ';' separated expressions of a file
+ * @param calc An Arithmo Interpreter object
+ * @param path The path of the file
+ * @param cbk The callback that is called with every expression and its result (valid only during the call,
+ *            ARTM_NULL_EXPR without one)
+ * @return The status of the whole operation
+ */
+extern artm_status_t artm_calc_eval_file(artm_calc_t* calc, const char* path, artm_stream_cbk_t cbk);
+
+/**
+ * @brief Evaluates many independent expressions in parallel (declarations are not allowed)
+ * @param calc An Arithmo Interpreter object
+ * @param expressions The mathematical expressions
+ * @param count The number of expressions
+ * @param results Where to store the evaluation results, in the order of the expressions
+ * @param nthreads The number of threads to use (0 for one per online CPU)
+ * @return The status of the whole operation
+ */
+extern artm_status_t artm_eval_many(
+  artm_calc_t* calc,
+  const char* const* expressions, size_t count,
+  artm_result_t* results, size_t nthreads
+);
+
+/**
+ * @brief Resolves a variable name to a handle that stays valid until artm_calc_free
+ * @param calc An Arithmo Interpreter object
+ * @param name The variable name
+ * @return The variable handle or NULL in case of an error
+ */
+extern artm_var_t artm_calc_var(artm_calc_t* calc, const char* name);
+
+/**
+ * @brief Declares a constant that compiled expressions inline and that can't be assigned afterwards
+ * @param calc An Arithmo Interpreter object
+ * @param name The constant name
+ * @param value The constant value
+ * @return The constant handle or NULL in case of an error (e.g. the name is already a different constant)
+ */
+extern artm_var_t artm_calc_const(artm_calc_t* calc, const char* name, double value);
+
+/**
+ * @brief Assigns many variables at once, like "$name = value" for each of them
+ * @param calc An Arithmo Interpreter object
+ * @param names The variable names
+ * @param values The values, in the order of the names
+ * @param count The number of variables
+ * @return The status of the operation (ARTM_INV_TOKEN for a name that is not an identifier,
+ *         ARTM_CONST_VAR for a constant); the variables before the failing one keep their new values
+ */
+extern artm_status_t artm_calc_set_vars(artm_calc_t* calc, const char* const* names, const double* values, size_t count);
+
+/**
+ * @brief Starts a batch of variable writes that consistent readers see all at once
+ *        (artm_calc_set_vars is such a batch by itself); batches can be nested
+ * @param calc An Arithmo Interpreter object
+ * @return The status of the operation
+ */
+extern artm_status_t artm_calc_write_begin(artm_calc_t* calc);
+
+/**
+ * @brief Ends the batch of variable writes started by artm_calc_write_begin
+ * @param calc An Arithmo Interpreter object
+ * @return The status of the operation
+ */
+extern artm_status_t artm_calc_write_end(artm_calc_t* calc);
+
+/**
+ * @brief Starts consistent reads: waits for the batch of writes in progress, if any
+ * @param calc An Arithmo Interpreter object
+ * @return The version to pass to artm_calc_read_retry
+ */
+extern size_t artm_calc_read_begin(const artm_calc_t* calc);
+
+/**
+ * @brief Tells whether a batch of writes ran since artm_calc_read_begin, in which
+ *        case the reads have to be done again
+ * @param calc An Arithmo Interpreter object
+ * @param version The version returned by artm_calc_read_begin
+ * @return true if the reads may have seen only part of a batch
+ */
+extern bool artm_calc_read_retry(const artm_calc_t* calc, size_t version);
+
+/**
+ * @brief Writes every defined variable, constant and formula of the calc to a binary file
+ * @param calc An Arithmo Interpreter object
+ * @param path The file to create (or overwrite)
+ * @return The status of the operation (ARTM_IO_ERR if the file can't be written)
+ */
+extern artm_status_t artm_calc_snapshot(artm_calc_t* calc, const char* path);
+
+/**
+ * @brief Loads the variables written by artm_calc_snapshot; the variables that are not
+ *        in the file keep their values
+ * @param calc An Arithmo Interpreter object
+ * @param path The file written by artm_calc_snapshot
+ * @return ARTM_SUCCESS; ARTM_BAD_FORMAT if the file is damaged or was written by another
+ *         version; ARTM_CONST_VAR if it assigns a constant of the calc (nothing is changed then);
+ *         or the status of the first formula that can't be defined again (e.g. ARTM_UNDEF_FN)
+ */
+extern artm_status_t artm_calc_restore(artm_calc_t* calc, const char* path);
+
+/**
+ * @brief Registers a function that expressions can call as name(a, b, ...)
+ * @param calc An Arithmo Interpreter object
+ * @param name The function name (replaces a built-in or registered function with the same name and arity)
+ * @param arity The number of arguments (at most ARTM_FN_MAX_ARITY)
+ * @param fn The function
+ * @param flags ARTM_FN_PURE if the result only depends on the arguments, so calls with constant arguments are folded
+ * @return The status of the operation (ARTM_INV_TOKEN if the name or the arity is invalid)
+ */
+extern artm_status_t artm_calc_register_fn(artm_calc_t* calc, const char* name, size_t arity, artm_fn_t fn, unsigned flags);
+
+/**
+ * @brief Registers a function that also has a version processing whole blocks of rows in artm_expr_eval_batch
+ * @param calc An Arithmo Interpreter object
+ * @param name The function name
+ * @param arity The number of arguments (at most ARTM_FN_MAX_ARITY)
+ * @param fn The function, used outside of batches
+ * @param vec The block version (constant arguments are passed as blocks of copies)
+ * @param flags Same as for artm_calc_register_fn
+ * @return The status of the operation
+ */
+extern artm_status_t artm_calc_register_vec_fn(
+  artm_calc_t* calc,
+  const char* name, size_t arity,
+  artm_fn_t fn, artm_vec_fn_t vec,
+  unsigned flags
+);
+
+/**
+ * @brief Recomputes every formula ("$x := ...") whose inputs changed, inputs first
+ * @param calc An Arithmo Interpreter object
+ * @return The status of the operation
+ */
+extern artm_status_t artm_calc_refresh(artm_calc_t* calc);
+
+/**
+ * @brief Sets (and declares) the value of a variable, replacing its formula (constants are left unchanged)
+ * @param var A variable handle
+ * @param value The new value
+ * @return Void
+ */
+extern void artm_var_set(artm_var_t var, double value);
+
+/**
+ * @brief Reads the current value of a variable (formulas are recomputed first if their inputs changed)
+ * @param var A variable handle
+ * @return The variable value or 0 if it was never declared
+ */
+extern double artm_var_get(artm_var_t var);
+
+/**
+ * @brief Compiles the given mathematical expression into a reusable program
+ * @param calc An Arithmo Interpreter object
+ * @param expression The mathematical expression
+ * @param error Where to store the compilation status (may be NULL)
+ * @return The compiled expression or NULL in case of an error
+ */
+extern artm_expr_t* artm_calc_compile(artm_calc_t* calc, const char* expression, artm_result_t* error);
+
+/**
+ * @brief Compiles the given mathematical expression with explicit optimization flags
+ * @param calc An Arithmo Interpreter object
+ * @param expression The mathematical expression
+ * @param flags A combination of artm_opt_t values (ARTM_OPT_FAST_MATH allows rewrites like x * 0 = 0 that ignore NaN, infinities and signed zeros,
+ *              ARTM_OPT_JIT generates native code when built with ARITHMO_JIT on x86-64 and is ignored otherwise)
+ * @param error Where to store the compilation status (may be NULL)
+ * @return The compiled expression or NULL in case of an error
+ */
+extern artm_expr_t* artm_calc_compile_ex(artm_calc_t* calc, const char* expression, unsigned flags, artm_result_t* error);
+
+/**
+ * @brief Evaluates a compiled expression using the current variable values
+ * @param expr A compiled expression
+ * @return The evaluation result structure
+ */
+extern artm_result_t artm_expr_eval(const artm_expr_t* expr);
+
+/**
+ * @brief Evaluates a compiled expression using the current variable values
+ * @param expr A compiled expression
+ * @param cbk The callback that is called in case of an error
+ * @return The evaluation result value
+ */
+extern double artm_expr_cbk_eval(const artm_expr_t* expr, artm_cbk_t cbk);
+
+/**
+ * @brief Evaluates a compiled expression once per row of the given columns
+ * @param expr A compiled expression
+ * @param columns The variables bound to caller-owned columns of rows values (not copied)
+ * @param count The number of columns
+ * @param results Where to store the rows results
+ * @param rows The number of rows
+ * @return The evaluation status (unbound variables use their current value)
+ */
+extern artm_result_t artm_expr_eval_batch(
+  const artm_expr_t* expr,
+  const artm_column_t* columns, size_t count,
+  double* results, size_t rows
+);
+
+/**
+ * @brief Evaluates a compiled expression together with its partial derivatives, in one forward pass
+ *        (formulas are differentiated through their inputs unless they are among the variables,
+ *        registered functions by a central difference around each call)
+ * @param expr A compiled expression
+ * @param vars The variables to differentiate with respect to
+ * @param count The number of variables
+ * @param gradient Where to store the count partial derivatives, in the order of the variables
+ * @return The evaluation result structure (with the value of the expression)
+ */
+extern artm_result_t artm_expr_eval_grad(const artm_expr_t* expr, const artm_var_t* vars, size_t count, double* gradient);
+
+/**
+ * @brief Evaluates a compiled expression together with its derivatives along many directions,
+ *        which are computed side by side in SIMD lanes
+ * @param expr A compiled expression
+ * @param vars The variables that move along the directions
+ * @param count The number of variables
+ * @param seeds The count rows of directions values: row i holds how much vars[i] moves along each direction
+ * @param directions The number of directions
+ * @param derivatives Where to store the directions derivatives
+ * @return The evaluation result structure (with the value of the expression)
+ */
+extern artm_result_t artm_expr_eval_tangents(
+  const artm_expr_t* expr,
+  const artm_var_t* vars, size_t count,
+  const double* seeds, size_t directions,
+  double* derivatives
+);
+
+/**
+ * @brief Evaluates the given mathematical expression together with its partial derivatives,
+ *        like artm_expr_eval_grad (declarations are not allowed and give ARTM_READ_ONLY)
+ * @param calc An Arithmo Interpreter object
+ * @param expression The mathematical expression
+ * @param vars The variables to differentiate with respect to
+ * @param count The number of variables
+ * @param gradient Where to store the count partial derivatives, in the order of the variables
+ * @return The evaluation result structure
+ */
+extern artm_result_t artm_calc_eval_grad(
+  artm_calc_t* calc, const char* expression,
+  const artm_var_t* vars, size_t count,
+  double* gradient
+);
+
+/**
+ * @brief Prints the program of a compiled expression, one instruction per line
+ * @param expr A compiled expression
+ * @param stream Where to print the program
+ * @return Void
+ */
+extern void artm_expr_dump(const artm_expr_t* expr, FILE* stream);
+
+/**
+ * @brief Deallocates the memory previously allocated by a call to artm_calc_compile
+ * @param expr A compiled expression
+ * @return Void
+ */
+extern void artm_expr_free(artm_expr_t* expr);
+
+/**
+ * @brief Compiles a script of statements separated by ';' or new lines, so it can be run
+ *        again whenever the variables change (formulas "$x := ..." are not allowed, like in artm_calc_compile)
+ * @param calc An Arithmo Interpreter object
+ * @param script The statements (empty ones are skipped)
+ * @param error Where to store the compilation status, with a token pointing into the script (may be NULL)
+ * @return The compiled script or NULL in case of an error
+ */
+extern artm_script_t* artm_calc_compile_script(artm_calc_t* calc, const char* script, artm_result_t* error);
+
+/**
+ * @brief Runs the statements of a compiled script in order, using the current variable values
+ * @param script A compiled script
+ * @param results Where to store the result of each statement, in order (may be NULL)
+ * @param count The capacity of results on input, the number of statements run on output (may be NULL)
+ * @return The result of the last statement, or of the first one that fails (its token points into
+ *         the copy of the text kept by the script, which is valid until artm_script_free)
+ */
+extern artm_result_t artm_script_eval(const artm_script_t* script, artm_result_t* results, size_t* count);
+
+/**
+ * @brief Deallocates the memory previously allocated by a call to artm_calc_compile_script
+ * @param script A compiled script
+ * @return Void
+ */
+extern void artm_script_free(artm_script_t* script);
+
+/**
+ * @brief Writes compiled expressions to a binary file that artm_expr_load can map back
+ * @param exprs The compiled expressions
+ * @param count The number of expressions
+ * @param path The file to create (or overwrite)
+ * @return ARTM_SUCCESS; ARTM_BAD_FORMAT if an expression is 4 GiB or longer;
+ *         or ARTM_NULL_EXPR, ARTM_ALLOC_ERR or ARTM_IO_ERR
+ */
+extern artm_status_t artm_expr_save(const artm_expr_t* const* exprs, size_t count, const char* path);
+
+/**
+ * @brief Loads the expressions written by artm_expr_save without parsing them again
+ * @param calc The calc that will own the expressions (their variables are created in it)
+ * @param path The file written by artm_expr_save
+ * @param exprs Where to store the expressions, in the order they were saved
+ * @param count The number of expressions the file must hold
+ * @return ARTM_SUCCESS; ARTM_BAD_FORMAT if the file is damaged, holds a different number
+ *         of expressions, was written by another version (compile the text again then) or
+ *         holds an expression nested deeper than the max_depth of calc allows;
+ *         ARTM_UNDEF_FN if a function it calls is not registered with the same arity;
+ *         or ARTM_NULL_CALC, ARTM_NULL_EXPR, ARTM_ALLOC_ERR or ARTM_IO_ERR.
+ *         On failure no expression is created.
+ */
+extern artm_status_t artm_expr_load(artm_calc_t* calc, const char* path, artm_expr_t** exprs, size_t count);
+
+/**
+ * @brief Compiles a set of formulas into one graph where identical sub-expressions are computed once
+ * @param calc An Arithmo Interpreter object
+ * @param expressions The mathematical expressions (declarations are not allowed)
+ * @param count The number of expressions
+ * @param error Where to store the compilation status (may be NULL, the token points into the failed expression)
+ * @return The compiled set or NULL in case of an error
+ */
+extern artm_exprset_t* artm_calc_compile_set(
+  artm_calc_t* calc,
+  const char* const* expressions, size_t count,
+  artm_result_t* error
+);
+
+/**
+ * @brief Evaluates every formula of a set in one pass using the current variable values
+ * @param set A compiled set
+ * @param results Where to store the results, in the order of the expressions
+ * @return The status of the whole operation
+ */
+extern artm_status_t artm_exprset_eval(const artm_exprset_t* set, artm_result_t* results);
+
+/**
+ * @brief Reports how many nodes of a set were shared between or within its formulas
+ * @param set A compiled set
+ * @param stats Where to store the counts (shared_nodes = nodes - unique_nodes)
+ * @return Void
+ */
+extern void artm_exprset_stats(const artm_exprset_t* set, artm_exprset_stats_t* stats);
+
+/**
+ * @brief Deallocates the memory previously allocated by a call to artm_calc_compile_set
+ * @param set A compiled set
+ * @return Void
+ */
+extern void artm_exprset_free(artm_exprset_t* set);
+
 #endif // ARITHMO_H
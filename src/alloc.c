@@ -0,0 +1,127 @@
+/* Alloc - Allocator callbacks and arenas
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdalign.h>
+
+#include "alloc.h"
+
+#define ARENA_ALIGN alignof(max_align_t)
+
+struct arena_chunk {
+  arena_chunk_t* next;
+  alignas(ARENA_ALIGN) char data[];
+};
+
+static void* default_allocate(size_t size, void* payload);
+static void* default_reallocate(void* pointer, size_t size, void* payload);
+static void default_release(void* pointer, void* payload);
+
+const artm_allocator_t alloc_default = {
+  .allocate = default_allocate,
+  .reallocate = default_reallocate,
+  .release = default_release,
+  .payload = NULL
+};
+
+static inline size_t align_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// The pointer that was allocated is kept right before the aligned block
+extern void* alloc_aligned(const artm_allocator_t* allocator, size_t alignment, size_t size) {
+  size_t extra = alignment - 1 + sizeof(void*);
+  if (size > SIZE_MAX - extra)
+    return NULL;
+
+  char* base = (char*) alloc_new(allocator, size + extra);
+  if (base == NULL)
+    return NULL;
+
+  uintptr_t start = ((uintptr_t) (base + sizeof(void*)) + alignment - 1) & ~(uintptr_t) (alignment - 1);
+  void** block = (void**) start;
+  block[-1] = base;
+  return block;
+}
+
+extern void alloc_aligned_free(const artm_allocator_t* allocator, void* pointer) {
+  if (pointer != NULL)
+    alloc_free(allocator, ((void**) pointer)[-1]);
+}
+
+extern void arena_init(arena_t* arena, const artm_allocator_t* allocator) {
+  arena->allocator = allocator;
+  arena->chunks = NULL;
+  arena->next = arena->end = NULL;
+  arena->chunk_size = ARENA_MIN_CHUNK;
+}
+
+extern void arena_free(arena_t* arena) {
+  while (arena->chunks != NULL) {
+    arena_chunk_t* chunk = arena->chunks;
+    arena->chunks = chunk->next;
+    alloc_free(arena->allocator, chunk);
+  }
+  arena->next = arena->end = NULL;
+}
+
+// A request bigger than a whole chunk gets a chunk of its own, and the
+// current one stays in use for the next requests
+extern void* arena_alloc(arena_t* arena, size_t size) {
+  size = align_up(size > 0 ? size : 1, ARENA_ALIGN);
+  if (size <= (size_t) (arena->end - arena->next)) {
+    void* result = arena->next;
+    arena->next += size;
+    return result;
+  }
+
+  size_t capacity = size > arena->chunk_size ? size : arena->chunk_size;
+  if (capacity > SIZE_MAX - sizeof(arena_chunk_t))
+    return NULL;
+
+  arena_chunk_t* chunk = (arena_chunk_t*) alloc_new(arena->allocator, sizeof(arena_chunk_t) + capacity);
+  if (chunk == NULL)
+    return NULL;
+
+  if (arena->chunks != NULL && size > arena->chunk_size) {
+    chunk->next = arena->chunks->next;
+    arena->chunks->next = chunk;
+    return chunk->data;
+  }
+
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  arena->next = chunk->data + size;
+  arena->end = chunk->data + capacity;
+  if (arena->chunk_size < ARENA_MAX_CHUNK)
+    arena->chunk_size *= 2;
+  return chunk->data;
+}
+
+static void* default_allocate(size_t size, __attribute__((unused)) void* payload) {
+  return malloc(size);
+}
+
+static void* default_reallocate(void* pointer, size_t size, __attribute__((unused)) void* payload) {
+  return realloc(pointer, size);
+}
+
+static void default_release(void* pointer, __attribute__((unused)) void* payload) {
+  free(pointer);
+}
@@ -0,0 +1,87 @@
+/* Alloc - Allocator callbacks and arenas
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_ALLOC_H
+#define ARITHMO_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arithmo.h"
+
+// The chunks of an arena double from the first size up to the last one
+#define ARENA_MIN_CHUNK 4096
+#define ARENA_MAX_CHUNK (1 << 20)
+
+typedef struct arena arena_t;
+typedef struct arena_chunk arena_chunk_t;
+
+// Memory that is only given back all at once, when the arena is freed
+struct arena {
+  const artm_allocator_t* allocator;
+  arena_chunk_t* chunks;
+  char* next;
+  char* end;
+  size_t chunk_size;
+};
+
+// malloc, realloc and free
+extern const artm_allocator_t alloc_default;
+
+extern void* alloc_aligned(const artm_allocator_t* allocator, size_t alignment, size_t size);
+extern void alloc_aligned_free(const artm_allocator_t* allocator, void* pointer);
+
+extern void arena_init(arena_t* arena, const artm_allocator_t* allocator);
+extern void arena_free(arena_t* arena);
+extern void* arena_alloc(arena_t* arena, size_t size);
+
+static inline void* alloc_new(const artm_allocator_t* allocator, size_t size) {
+  return allocator->allocate(size, allocator->payload);
+}
+
+static inline void* alloc_zeroed(const artm_allocator_t* allocator, size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size)
+    return NULL;
+
+  void* pointer = allocator->allocate(count * size, allocator->payload);
+  if (pointer != NULL)
+    memset(pointer, 0, count * size);
+  return pointer;
+}
+
+static inline void* alloc_resize(const artm_allocator_t* allocator, void* pointer, size_t size) {
+  return allocator->reallocate(pointer, size, allocator->payload);
+}
+
+static inline void alloc_free(const artm_allocator_t* allocator, void* pointer) {
+  if (pointer != NULL)
+    allocator->release(pointer, allocator->payload);
+}
+
+static inline char* alloc_strndup(const artm_allocator_t* allocator, const char* text, size_t size) {
+  char* copy = (char*) allocator->allocate(size + 1, allocator->payload);
+  if (copy != NULL) {
+    memcpy(copy, text, size);
+    copy[size] = '\0';
+  }
+  return copy;
+}
+
+#endif // ARITHMO_ALLOC_H
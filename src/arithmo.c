@@ -22,81 +22,138 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #include "arithmo.h"
-#include "table.h"
+#include "alloc.h"
+#include "calc.h"
+#include "cache.h"
+#include "compiler.h"
+#include "func.h"
+#include "graph.h"
 #include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "pool.h"
+#include "result.h"
 
-#define ARTM_VALUE(_value_) \
-  ((artm_result_t) { ARTM_SUCCESS, { .value = (_value_) } })
-
-#define ARTM_ERROR(_status_, _token_) \
-  ((artm_result_t) { (_status_), { .token = { (_token_).size, (_token_).target } } })
-
-#define ARTM_CHECK_TOKEN(_calc_) \
-  do { \
-    if (check(_calc_, TKN_ERROR)) { \
-      return ARTM_ERROR(ARTM_INV_TOKEN, _calc_->token); \
-    } \
-  } while (0)
-
-#define ARTM_CHECK_RESULT(_var_name_) \
-  do { \
-    if (_var_name_.status != ARTM_SUCCESS) { \
-      return _var_name_; \
-    } \
-  } while (0)
-
-#define ARTM_ADVANCE(_calc_) \
-  do { \
-    _calc_->token = lexer_next(&_calc_->lexer); \
-    ARTM_CHECK_TOKEN(_calc_); \
-  } while (0)
-
-#define ARTM_CONSUME(_calc_, _type_, _status_) \
-  do { \
-    if (_calc_->token.type == _type_) { \
-      ARTM_ADVANCE(_calc_); \
-    } else { \
-      return ARTM_ERROR(_status_, _calc_->token); \
-    } \
-  } while (0)
-
-struct artm_calc {
-  table_t decls;
-  lexer_t lexer;
-  token_t token;
+typedef struct many many_t;
+
+struct many {
+  artm_calc_t* calc;
+  const char* const* expressions;
+  artm_result_t* results;
 };
 
-static artm_result_t parse_decl(artm_calc_t* calc);
-static artm_result_t parse_call(artm_calc_t* calc);
-static artm_result_t parse_expr(artm_calc_t* calc);
-static artm_result_t parse_term(artm_calc_t* calc);
-static artm_result_t parse_factor(artm_calc_t* calc);
-static artm_result_t parse_paren(artm_calc_t* calc);
+static void eval_range(void* payload, size_t begin, size_t end);
+static artm_result_t evaluate(artm_calc_t* calc, const char* expression, size_t size, bool readonly);
+static artm_result_t interpret(artm_calc_t* calc, const char* expression, size_t size, bool readonly);
+static void cache_expression(artm_calc_t* calc, uint64_t hash, const char* expression, size_t size);
 
-static inline bool check(artm_calc_t* calc, token_type_t type) {
-  return calc->token.type == type;
-}
+static artm_result_t parse(parser_t* parser, bool readonly);
+
+static artm_result_t parse_decl(parser_t* parser);
+static artm_result_t parse_formula(parser_t* parser, token_t id);
 
-static inline bool match(artm_calc_t* calc, token_type_t type1, token_type_t type2) {
-  return check(calc, type1) || check(calc, type2);
+static artm_status_t set_vars(artm_calc_t* calc, const char* const* names, const double* values, size_t count);
+static void free_var(artm_var_t var, void* payload);
+
+// The name has to lex as a single identifier
+static inline bool is_name(const char* name, size_t size) {
+  lexer_t lexer;
+  lexer_init(&lexer, name, size);
+  token_t token = lexer_next(&lexer);
+  return token.type == TKN_ID && token.size == size;
 }
 
 extern artm_calc_t* artm_calc_init(size_t decl_table_size) {
-  artm_calc_t* result = (artm_calc_t*) malloc(sizeof(artm_calc_t));
+  artm_config_t config = { .decl_table_size = decl_table_size, .cache_capacity = CALC_CACHE_CAPACITY };
+  return artm_calc_init_ex(&config);
+}
+
+extern artm_calc_t* artm_calc_init_ex(const artm_config_t* config) {
+  if (config == NULL) {
+    return NULL;
+  }
+
+  // Either all the callbacks or none of them
+  const artm_allocator_t* allocator = &config->allocator;
+  bool custom = allocator->allocate != NULL;
+  if (custom != (allocator->reallocate != NULL) || custom != (allocator->release != NULL)) {
+    return NULL;
+  }
+
+  if (!custom) {
+    allocator = &alloc_default;
+  }
+
+  artm_calc_t* result = (artm_calc_t*) alloc_new(allocator, sizeof(artm_calc_t));
   if (result == NULL) {
     return NULL;
   }
 
-  table_init(&result->decls, decl_table_size);
+  result->allocator = *allocator;
+  arena_init(&result->arena, &result->allocator);
+  parser_spare_init(&result->spare);
+  result->parent = NULL;
+  store_init(&result->decls, config->decl_table_size, &result->allocator);
+  table_init(&result->funcs, 0, &result->allocator);
+  cache_init(&result->cache, config->cache_capacity, &result->allocator);
+  STATS(stats_init(&result->stats, config->stats_latency);)
+  STATS(result->decls.stats = &result->stats;)
+  pthread_mutex_init(&result->lock, NULL);
+  result->pool = NULL;
+  result->dirty = NULL;
+  result->mark = 0;
+  result->max_depth = config->max_depth > 0 ? config->max_depth : ARTM_DEFAULT_MAX_DEPTH;
+  atomic_init(&result->version, 0);
+  result->writing = 0;
   return result;
 }
 
+// Nothing of the parent is copied: a fork starts with empty tables and
+// borrows the parent's settings
+extern artm_calc_t* artm_calc_fork(artm_calc_t* parent) {
+  if (parent == NULL) {
+    return NULL;
+  }
+
+  artm_config_t config = {
+    .decl_table_size = 0,
+    .cache_capacity = parent->cache.capacity,
+    .max_depth = parent->max_depth,
+    STATS(.stats_latency = parent->stats.timing,)
+    .allocator = parent->allocator
+  };
+
+  artm_calc_t* fork = artm_calc_init_ex(&config);
+  if (fork != NULL) {
+    fork->parent = parent;
+  }
+  return fork;
+}
+
 extern void artm_calc_free(artm_calc_t* calc) {
   if (calc != NULL) {
-    table_free(&calc->decls);
-    free(calc);
+    if (calc->pool != NULL) {
+      pool_free(calc->pool);
+      alloc_free(&calc->allocator, calc->pool);
+    }
+
+    // The variables and functions go away with the chunks of the arena
+    pthread_mutex_destroy(&calc->lock);
+    cache_free(&calc->cache);
+    store_each(&calc->decls, free_var, NULL);
+    store_free(&calc->decls);
+    table_free(&calc->funcs);
+    parser_spare_free(&calc->spare, &calc->allocator);
+    arena_free(&calc->arena);
+
+    artm_allocator_t allocator = calc->allocator;
+    alloc_free(&allocator, calc);
   }
 }
 
@@ -104,23 +161,167 @@ extern artm_result_t artm_calc_eval(artm_calc_t* calc, const char* expression) {
   if (calc == NULL) {
     return ARTM_ERROR(ARTM_NULL_CALC, (token_t) { 0 });
   }
+  if (expression == NULL) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+  return calc_eval(calc, expression, strlen(expression), false);
+}
+
+extern artm_result_t artm_calc_evaln(artm_calc_t* calc, const char* expression, size_t size) {
+  if (calc == NULL) {
+    return ARTM_ERROR(ARTM_NULL_CALC, (token_t) { 0 });
+  }
 
   if (expression == NULL) {
     return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
   }
+  return calc_eval(calc, expression, size, false);
+}
 
-  lexer_init(&calc->lexer, expression);
-  calc->token = lexer_next(&calc->lexer);
-  switch (calc->token.type) {
-    case TKN_ERROR:
-      return ARTM_ERROR(ARTM_INV_TOKEN, calc->token);
-    case TKN_END:
-      return ARTM_VALUE(0);
-    case TKN_DOLLAR:
-      return parse_decl(calc);
-    default:
-      return parse_expr(calc);
+extern artm_status_t artm_eval_many(
+  artm_calc_t* calc,
+  const char* const* expressions, size_t count,
+  artm_result_t* results, size_t nthreads
+) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
   }
+
+  if (expressions == NULL || results == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  if (nthreads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = online > 0 ? (size_t) online : 1;
+  }
+
+  many_t many = { calc, expressions, results };
+  if (nthreads == 1 || count < 2) {
+    eval_range(&many, 0, count);
+    return ARTM_SUCCESS;
+  }
+
+  pthread_mutex_lock(&calc->lock);
+  if (calc->pool != NULL && calc->pool->size != nthreads) {
+    pool_free(calc->pool);
+    alloc_free(&calc->allocator, calc->pool);
+    calc->pool = NULL;
+  }
+
+  if (calc->pool == NULL) {
+    calc->pool = (pool_t*) alloc_new(&calc->allocator, sizeof(pool_t));
+    if (calc->pool != NULL && !pool_init(calc->pool, nthreads, &calc->allocator)) {
+      alloc_free(&calc->allocator, calc->pool);
+      calc->pool = NULL;
+    }
+  }
+
+  if (calc->pool != NULL) {
+    pool_run(calc->pool, count, eval_range, &many);
+  } else {
+    eval_range(&many, 0, count);
+  }
+  pthread_mutex_unlock(&calc->lock);
+  return ARTM_SUCCESS;
+}
+
+static void eval_range(void* payload, size_t begin, size_t end) {
+  many_t* many = (many_t*) payload;
+  for (size_t i = begin; i < end; ++i) {
+    const char* expression = many->expressions[i];
+    many->results[i] = expression != NULL
+      ? calc_eval(many->calc, expression, strlen(expression), true)
+      : ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+}
+
+extern void artm_calc_cache_stats(artm_calc_t* calc, artm_cache_stats_t* stats) {
+  if (calc != NULL && stats != NULL) {
+    cache_stats(&calc->cache, stats);
+  }
+}
+
+extern artm_status_t artm_calc_stats(artm_calc_t* calc, artm_stats_t* stats) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  if (stats != NULL) {
+    memset(stats, 0, sizeof(artm_stats_t));
+    STATS(stats_snapshot(&calc->stats, stats);)
+  }
+  return ARTM_SUCCESS;
+}
+
+extern artm_status_t artm_calc_stats_hook(artm_calc_t* calc, __attribute__((unused)) artm_stats_hook_t hook) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  STATS(calc->stats.hook = hook;)
+  return ARTM_SUCCESS;
+}
+
+extern artm_result_t calc_eval(artm_calc_t* calc, const char* expression, size_t size, bool readonly) {
+  STATS(uint64_t start = stats_start(&calc->stats);)
+  artm_result_t result = evaluate(calc, expression, size, readonly);
+  STATS(stats_eval(&calc->stats, result.status, start);)
+  return result;
+}
+
+// A text is compiled the second time it is evaluated, and the ones that
+// are too long for the cache are not even hashed
+static artm_result_t evaluate(artm_calc_t* calc, const char* expression, size_t size, bool readonly) {
+  bool cacheable = calc->cache.capacity > 0 && size <= CALC_CACHE_MAX_SIZE;
+  uint64_t hash = cacheable ? table_hash(expression, size) : 0;
+  bool seen = cacheable && cache_seen(&calc->cache, hash);
+  cache_entry_t* entry = seen ? cache_get(&calc->cache, hash, expression, size) : NULL;
+  if (entry != NULL && !(readonly && entry->declaration)) {
+    artm_result_t result = program_run(&entry->program);
+    // Point the error token back into the caller's text
+    if (result.status != ARTM_SUCCESS && result.as.token.target != NULL)
+      result.as.token.target = expression + (result.as.token.target - entry->source);
+    cache_release(entry);
+    return result;
+  }
+
+  if (entry != NULL) {
+    cache_release(entry);
+  }
+
+  artm_result_t result = interpret(calc, expression, size, readonly);
+  if (result.status == ARTM_SUCCESS && seen && entry == NULL) {
+    cache_expression(calc, hash, expression, size);
+  }
+  return result;
+}
+
+// Only expressions that were just evaluated successfully are compiled, so
+// every name they use already has a slot and the calc is never modified
+static void cache_expression(artm_calc_t* calc, uint64_t hash, const char* expression, size_t size) {
+  cache_entry_t* entry = cache_entry_new(&calc->cache, hash, expression, size);
+  if (entry == NULL) {
+    return;
+  }
+
+  artm_result_t result = compile(calc, &entry->program, entry->source, size, false);
+  if (result.status != ARTM_SUCCESS || !optimize(&entry->program, ARTM_OPT_DEFAULT)) {
+    cache_release(entry);
+    return;
+  }
+
+  entry->declaration = entry->program.code[entry->program.size - 1].op == OP_STORE;
+  cache_release(cache_put(&calc->cache, entry));
+}
+
+static artm_result_t interpret(artm_calc_t* calc, const char* expression, size_t size, bool readonly) {
+  parser_t parser;
+  parser_init(&parser, calc, expression, size);
+  artm_result_t result = parse(&parser, readonly);
+  STATS(stats_add(&calc->stats.tokens, parser.lexer.tokens);)
+  parser_free(&parser);
+  return result;
 }
 
 extern double artm_calc_cbk_eval(artm_calc_t* calc, const char* expression, artm_cbk_t callback) {
@@ -132,113 +333,332 @@ extern double artm_calc_cbk_eval(artm_calc_t* calc, const char* expression, artm
   return 0;
 }
 
-static artm_result_t parse_decl(artm_calc_t* calc) {
-  ARTM_ADVANCE(calc);
-
-  token_t id = calc->token;
+extern artm_var_t artm_calc_var(artm_calc_t* calc, const char* name) {
+  if (calc == NULL || name == NULL) {
+    return NULL;
+  }
+  return calc_resolve(calc, name, strlen(name));
+}
 
-  ARTM_CONSUME(calc, TKN_ID, ARTM_INV_TOKEN);
-  ARTM_CONSUME(calc, TKN_EQUAL, ARTM_INV_TOKEN);
+extern artm_var_t artm_calc_const(artm_calc_t* calc, const char* name, double value) {
+  if (calc == NULL || name == NULL) {
+    return NULL;
+  }
 
-  artm_result_t result = parse_expr(calc);
-  ARTM_CHECK_RESULT(result);
+  artm_var_t var = calc_resolve(calc, name, strlen(name));
+  if (var == NULL) {
+    return NULL;
+  }
 
-  char* name = strndup(id.target, id.size);
-  if (name == NULL) {
-    return ARTM_ERROR(ARTM_ALLOC_ERR, id);
+  double current = var_value(var);
+  if (var->constant && memcmp(&current, &value, sizeof(value)) != 0) {
+    return NULL;
   }
 
-  table_put(&calc->decls, name, TABLE_DBL_VALUE(result.as.value));
-  free(name);
-  return result;
+  graph_clear(var);
+  var->constant = true;
+  var_store(var, value);
+  graph_touch(var);
+  return var;
 }
 
-static artm_result_t parse_expr(artm_calc_t* calc) {
-  artm_result_t result = parse_term(calc);
-  ARTM_CHECK_RESULT(result);
+// The store grows once for all the new names instead of doubling its way
+// up, and readers that ask for consistent reads see all the values or none
+extern artm_status_t artm_calc_set_vars(artm_calc_t* calc, const char* const* names, const double* values, size_t count) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
 
-  while (match(calc, TKN_PLUS, TKN_MINUS)) {
-    token_t token = calc->token;
-    ARTM_ADVANCE(calc);
+  if ((names == NULL || values == NULL) && count > 0) {
+    return ARTM_NULL_EXPR;
+  }
 
-    artm_result_t next = parse_term(calc);
-    ARTM_CHECK_RESULT(next);
+  if (!store_reserve(&calc->decls, calc->decls.count + count)) {
+    return ARTM_ALLOC_ERR;
+  }
 
-    result = token.type == TKN_PLUS
-      ? ARTM_VALUE(result.as.value + next.as.value)
-      : ARTM_VALUE(result.as.value - next.as.value);
+  artm_calc_write_begin(calc);
+  artm_status_t status = set_vars(calc, names, values, count);
+  artm_calc_write_end(calc);
+  return status;
+}
+
+// The version is odd while a write is in progress. The values are stored
+// with release and loaded with acquire, so a reader that sees a value
+// written after the odd version also sees that version when it retries
+extern artm_status_t artm_calc_write_begin(artm_calc_t* calc) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
   }
 
-  ARTM_CHECK_TOKEN(calc);
-  return result;
+  if (calc->writing++ == 0) {
+    atomic_fetch_add_explicit(&calc->version, 1, memory_order_acq_rel);
+  }
+  return ARTM_SUCCESS;
 }
 
-static artm_result_t parse_term(artm_calc_t* calc) {
-  artm_result_t result = parse_factor(calc);
-  ARTM_CHECK_RESULT(result);
+extern artm_status_t artm_calc_write_end(artm_calc_t* calc) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  if (calc->writing > 0 && --calc->writing == 0) {
+    atomic_fetch_add_explicit(&calc->version, 1, memory_order_release);
+  }
+  return ARTM_SUCCESS;
+}
 
-  while (match(calc, TKN_STAR, TKN_SLASH)) {
-    token_t token = calc->token;
-    ARTM_ADVANCE(calc);
+extern size_t artm_calc_read_begin(const artm_calc_t* calc) {
+  if (calc == NULL) {
+    return 0;
+  }
 
-    artm_result_t next = parse_factor(calc);
-    ARTM_CHECK_RESULT(next);
+  size_t version;
+  while ((version = atomic_load_explicit(&calc->version, memory_order_acquire)) & 1) {
+    sched_yield();
+  }
+  return version;
+}
 
-    result = token.type == TKN_STAR
-      ? ARTM_VALUE(result.as.value * next.as.value)
-      : ARTM_VALUE(result.as.value / next.as.value);
+extern bool artm_calc_read_retry(const artm_calc_t* calc, size_t version) {
+  if (calc == NULL) {
+    return false;
   }
 
-  ARTM_CHECK_TOKEN(calc);
-  return result;
+  return atomic_load_explicit(&calc->version, memory_order_acquire) != version;
 }
 
-static artm_result_t parse_factor(artm_calc_t* calc) {
-  token_t token = calc->token;
-  switch (token.type) {
-    case TKN_NUMBER:
-      ARTM_ADVANCE(calc);
-      return ARTM_VALUE(strtod(token.target, NULL));
-    case TKN_MINUS: {
-      ARTM_ADVANCE(calc);
-      artm_result_t result = parse_factor(calc);
-      ARTM_CHECK_RESULT(result);
-      return ARTM_VALUE(-result.as.value);
+extern artm_status_t artm_calc_register_fn(artm_calc_t* calc, const char* name, size_t arity, artm_fn_t fn, unsigned flags) {
+  return artm_calc_register_vec_fn(calc, name, arity, fn, NULL, flags);
+}
+
+extern artm_status_t artm_calc_register_vec_fn(
+  artm_calc_t* calc,
+  const char* name, size_t arity,
+  artm_fn_t fn, artm_vec_fn_t vec,
+  unsigned flags
+) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  if (name == NULL || fn == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  size_t size = strlen(name);
+  if (!is_name(name, size) || arity > ARTM_FN_MAX_ARITY) {
+    return ARTM_INV_TOKEN;
+  }
+
+  // Compiled programs point to the function, so it is replaced in place
+  func_t* func = (func_t*) table_get(&calc->funcs, name, size).as.ptr;
+  if (func != NULL) {
+    if (func->arity != arity) {
+      return ARTM_INV_TOKEN;
     }
-    case TKN_PLUS: {
-      ARTM_ADVANCE(calc);
-      artm_result_t result = parse_factor(calc);
-      ARTM_CHECK_RESULT(result);
-      return result;
+    func->flags = flags;
+    func->as.array = fn;
+    func->vector = vec;
+  } else {
+    func = func_new(&calc->arena, name, arity, fn, vec, flags);
+    if (func == NULL || !table_put(&calc->funcs, func->name, size, TABLE_PTR_VALUE(func))) {
+      return ARTM_ALLOC_ERR;
     }
-    case TKN_ID:
-      return parse_call(calc);
-    case TKN_LPAREN:
-      return parse_paren(calc);
+  }
+
+  // The cached programs may call (or have folded) what the name meant before
+  cache_clear(&calc->cache);
+  return ARTM_SUCCESS;
+}
+
+extern artm_status_t artm_calc_refresh(artm_calc_t* calc) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  graph_refresh(calc);
+  return ARTM_SUCCESS;
+}
+
+// A plain value replaces the formula of the variable, if it had one
+extern void artm_var_set(artm_var_t var, double value) {
+  if (var->constant) {
+    return;
+  }
+
+  graph_clear(var);
+  var_store(var, value);
+  graph_touch(var);
+}
+
+extern double artm_var_get(artm_var_t var) {
+  if (var->dirty) {
+    graph_update(var);
+  }
+  return var_defined(var) ? var_value(var) : 0;
+}
+
+extern artm_var_t calc_find(const artm_calc_t* calc, const char* name, size_t size) {
+  artm_var_t var = store_get(&calc->decls, name, size);
+  return var != NULL || calc->parent == NULL ? var : calc_find(calc->parent, name, size);
+}
+
+// Functions are resolved once, when the expression is parsed or compiled,
+// and the registered ones take precedence over the built-in ones
+extern const func_t* calc_func(const artm_calc_t* calc, const char* name, size_t size) {
+  const func_t* func = (const func_t*) table_get(&calc->funcs, name, size).as.ptr;
+  if (func != NULL) {
+    return func;
+  }
+  return calc->parent != NULL ? calc_func(calc->parent, name, size) : func_find(name, size);
+}
+
+// A fork gets its own copy of a parent's variable the first time the
+// variable is written or compiled in, so the parent is never modified
+extern artm_var_t calc_resolve(artm_calc_t* calc, const char* name, size_t size) {
+  artm_var_t var = store_get(&calc->decls, name, size);
+  if (var != NULL) {
+    return var;
+  }
+
+  // The name follows the variable in the arena
+  var = (artm_var_t) arena_alloc(&calc->arena, sizeof(struct artm_var) + size + 1);
+  if (var == NULL) {
+    return NULL;
+  }
+  STATS(stats_alloc(&calc->stats, sizeof(struct artm_var) + size + 1);)
+
+  var->name = (char*) (var + 1);
+  memcpy(var->name, name, size);
+  var->name[size] = '\0';
+
+  atomic_init(&var->value, 0);
+  atomic_init(&var->defined, false);
+  var->constant = var->dirty = var->queued = false;
+  var->calc = calc;
+  var->formula = NULL;
+  var->next_dirty = var->next_work = NULL;
+  var->cursor = var->mark = 0;
+  var->dependents.items = NULL;
+  var->dependents.count = var->dependents.capacity = 0;
+
+  artm_var_t inherited = calc->parent != NULL ? calc_find(calc->parent, name, size) : NULL;
+  if (inherited != NULL) {
+    atomic_init(&var->value, var_value(inherited));
+    atomic_init(&var->defined, var_defined(inherited));
+    var->constant = inherited->constant;
+  }
+
+  // Readers can find the variable as soon as it is put
+  if (!store_put(&calc->decls, var, size)) {
+    return NULL;
+  }
+
+  // The cached programs of a fork may still read the parent's variable
+  if (inherited != NULL) {
+    cache_clear(&calc->cache);
+  }
+  return var;
+}
+
+static artm_result_t parse(parser_t* parser, bool readonly) {
+  parser->token = lexer_next(&parser->lexer);
+  if (parser_check(parser, TKN_END)) {
+    return ARTM_VALUE(0);
+  }
+  return calc_statement(parser, readonly);
+}
+
+extern artm_result_t calc_statement(parser_t* parser, bool readonly) {
+  switch (parser->token.type) {
+    case TKN_ERROR:
+      return ARTM_ERROR(ARTM_INV_TOKEN, parser->token);
+    case TKN_DOLLAR:
+      if (readonly)
+        return ARTM_ERROR(ARTM_READ_ONLY, parser->token);
+      return parse_decl(parser);
     default:
-      return ARTM_ERROR(ARTM_INV_TOKEN, token);
+      return parser_expr(parser);
   }
 }
 
-static artm_result_t parse_paren(artm_calc_t* calc) {
-  ARTM_ADVANCE(calc);
-  artm_result_t result = parse_expr(calc);
+static artm_result_t parse_decl(parser_t* parser) {
+  PARSER_ADVANCE(parser);
+
+  token_t id = parser->token;
+
+  PARSER_CONSUME(parser, TKN_ID, ARTM_INV_TOKEN);
+  if (parser_check(parser, TKN_DEFINE)) {
+    return parse_formula(parser, id);
+  }
+  PARSER_CONSUME(parser, TKN_EQUAL, ARTM_INV_TOKEN);
+
+  artm_result_t result = parser_expr(parser);
   ARTM_CHECK_RESULT(result);
-  ARTM_CONSUME(calc, TKN_RPAREN, ARTM_INV_TOKEN);
+
+  artm_var_t var = calc_resolve(parser->calc, id.target, id.size);
+  if (var == NULL) {
+    return ARTM_ERROR(ARTM_ALLOC_ERR, id);
+  }
+
+  if (var->constant) {
+    return ARTM_ERROR(ARTM_CONST_VAR, id);
+  }
+
+  artm_var_set(var, result.as.value);
+  return result;
+}
+
+// The rest of the statement is kept as a formula that is recomputed
+// whenever one of the variables it reads changes
+static artm_result_t parse_formula(parser_t* parser, token_t id) {
+  PARSER_ADVANCE(parser);
+  if (parser_check(parser, TKN_END) || parser_check(parser, TKN_SEMI)) {
+    return ARTM_ERROR(ARTM_INV_TOKEN, parser->token);
+  }
+
+  artm_var_t var = calc_resolve(parser->calc, id.target, id.size);
+  if (var == NULL) {
+    return ARTM_ERROR(ARTM_ALLOC_ERR, id);
+  }
+
+  if (var->constant) {
+    return ARTM_ERROR(ARTM_CONST_VAR, id);
+  }
+
+  const char* source = parser->token.target;
+  const char* end = lexer_statement_end(&parser->lexer, source);
+  artm_result_t result = graph_define(var, source, (size_t) (end - source));
+  parser->lexer.current = end;
+  parser->token = lexer_next(&parser->lexer);
   return result;
 }
 
-static artm_result_t parse_call(artm_calc_t* calc) {
-  token_t id = calc->token;
-  ARTM_ADVANCE(calc);
+static artm_status_t set_vars(artm_calc_t* calc, const char* const* names, const double* values, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (names[i] == NULL) {
+      return ARTM_NULL_EXPR;
+    }
+
+    size_t size = strlen(names[i]);
+    if (!is_name(names[i], size)) {
+      return ARTM_INV_TOKEN;
+    }
 
-  char* name = strndup(id.target, id.size);
-  table_value_t value = table_get(&calc->decls, name);
-  free(name);
+    artm_var_t var = calc_resolve(calc, names[i], size);
+    if (var == NULL) {
+      return ARTM_ALLOC_ERR;
+    }
 
-  if (value.type == TAB_VAL_PTR) {
-    return ARTM_ERROR(ARTM_UNDEF_VAR, id);
+    if (var->constant) {
+      return ARTM_CONST_VAR;
+    }
+    artm_var_set(var, values[i]);
   }
+  return ARTM_SUCCESS;
+}
 
-  return ARTM_VALUE(value.as.dbl);
+static void free_var(artm_var_t var, __attribute__((unused)) void* payload) {
+  graph_free(var);
 }
@@ -0,0 +1,308 @@
+/* Batch - Columnar evaluation of compiled programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "batch.h"
+#include "calc.h"
+#include "func.h"
+#include "graph.h"
+#include "kernels.h"
+#include "result.h"
+
+// Rows evaluated per block: the temporaries of a block stay in L1
+#define BATCH_BLOCK 256
+#define BATCH_ALIGN 64
+
+// Most programs fit, so nothing is allocated for them
+#define BATCH_INLINE_DEPTH 4
+#define BATCH_INLINE_SIZE 32
+
+typedef struct operand operand_t;
+typedef struct batch batch_t;
+
+struct operand {
+  const double* data;
+  bool scalar;
+};
+
+// The stacks of operands and scalars are sized by the depth of the program,
+// which can be large, so they are allocated like the temporaries
+struct batch {
+  const program_t* program;
+  const kernels_t* kernels;
+  const double** bindings;
+  double* temps;
+  operand_t* stack;
+  double* scalars;
+  size_t last;
+};
+
+static artm_result_t bind(batch_t* batch, const artm_column_t* columns, size_t count);
+static void release(batch_t* batch, bool own_temps, bool own_bindings);
+static void run_block(const batch_t* batch, double* results, size_t row, size_t size);
+static void run_call(const batch_t* batch, const func_t* func, operand_t* args, size_t position, double* out, size_t size);
+
+// The last instruction writes straight into the results
+static inline double* target(const batch_t* batch, double* results, size_t row, size_t index, size_t position) {
+  return index + 1 == batch->last ? results + row : batch->temps + position * BATCH_BLOCK;
+}
+
+static inline kernel_op_t kernel_op(opcode_t op) {
+  switch (op) {
+    case OP_ADD: return KERNEL_ADD;
+    case OP_SUB: return KERNEL_SUB;
+    case OP_MUL: return KERNEL_MUL;
+    default: return KERNEL_DIV;
+  }
+}
+
+static inline double apply(opcode_t op, double a, double b) {
+  switch (op) {
+    case OP_ADD: return a + b;
+    case OP_SUB: return a - b;
+    case OP_MUL: return a * b;
+    default: return a / b;
+  }
+}
+
+extern artm_result_t batch_run(
+  const program_t* program,
+  const artm_column_t* columns, size_t count,
+  double* results, size_t rows
+) {
+  batch_t batch = { .program = program, .kernels = kernels_select() };
+
+  // Stores only happen at the end of a program and keep the last row
+  batch.last = program->size;
+  while (batch.last > 0 && program->code[batch.last - 1].op == OP_STORE)
+    --batch.last;
+
+  // One more block than the depth, for the results of vector calls
+  _Alignas(BATCH_ALIGN) double inline_temps[(BATCH_INLINE_DEPTH + 1) * BATCH_BLOCK];
+  operand_t inline_stack[BATCH_INLINE_DEPTH];
+  double inline_scalars[BATCH_INLINE_DEPTH];
+  const double* inline_bindings[BATCH_INLINE_SIZE] = { 0 };
+  size_t depth = program->depth + 1;
+  bool own_temps = depth > BATCH_INLINE_DEPTH;
+  bool own_bindings = program->size > BATCH_INLINE_SIZE;
+  if (own_temps) {
+    batch.temps = (double*) alloc_aligned(program->allocator, BATCH_ALIGN, (depth + 1) * BATCH_BLOCK * sizeof(double));
+    batch.stack = (operand_t*) alloc_new(program->allocator, depth * sizeof(operand_t));
+    batch.scalars = (double*) alloc_new(program->allocator, depth * sizeof(double));
+  } else {
+    batch.temps = inline_temps;
+    batch.stack = inline_stack;
+    batch.scalars = inline_scalars;
+  }
+  batch.bindings = own_bindings
+    ? (const double**) alloc_zeroed(program->allocator, program->size, sizeof(const double*))
+    : inline_bindings;
+  if (batch.temps == NULL || batch.stack == NULL || batch.scalars == NULL || batch.bindings == NULL) {
+    release(&batch, own_temps, own_bindings);
+    return ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+  }
+
+  artm_result_t result = bind(&batch, columns, count);
+  if (result.status == ARTM_SUCCESS) {
+    for (size_t row = 0; row < rows; row += BATCH_BLOCK) {
+      size_t size = rows - row < BATCH_BLOCK ? rows - row : BATCH_BLOCK;
+      run_block(&batch, results, row, size);
+    }
+
+    for (size_t i = batch.last; i < program->size && rows > 0; ++i)
+      artm_var_set(program->code[i].as.var, results[rows - 1]);
+  }
+
+  release(&batch, own_temps, own_bindings);
+  return result;
+}
+
+static void release(batch_t* batch, bool own_temps, bool own_bindings) {
+  if (own_temps) {
+    alloc_aligned_free(batch->program->allocator, batch->temps);
+    alloc_free(batch->program->allocator, batch->stack);
+    alloc_free(batch->program->allocator, batch->scalars);
+  }
+  if (own_bindings)
+    alloc_free(batch->program->allocator, batch->bindings);
+}
+
+static artm_result_t bind(batch_t* batch, const artm_column_t* columns, size_t count) {
+  const program_t* program = batch->program;
+  for (size_t i = 0; i < batch->last; ++i) {
+    const instr_t* instr = &program->code[i];
+    if (instr->op != OP_LOAD)
+      continue;
+
+    for (size_t j = 0; j < count && batch->bindings[i] == NULL; ++j) {
+      if (columns[j].var == instr->as.var)
+        batch->bindings[i] = columns[j].data;
+    }
+
+    if (batch->bindings[i] == NULL && !var_defined(instr->as.var))
+      return ARTM_ERROR(ARTM_UNDEF_VAR, program->tokens[i]);
+    if (batch->bindings[i] == NULL && instr->as.var->dirty)
+      graph_update(instr->as.var);
+  }
+
+  for (size_t i = batch->last; i < program->size; ++i) {
+    if (program->code[i].as.var->constant)
+      return ARTM_ERROR(ARTM_CONST_VAR, program->tokens[i]);
+  }
+  return ARTM_VALUE(0);
+}
+
+static void run_block(const batch_t* batch, double* results, size_t row, size_t size) {
+  const program_t* program = batch->program;
+  const kernels_t* kernels = batch->kernels;
+
+  operand_t* stack = batch->stack;
+  double* scalars = batch->scalars;
+  size_t top = 0;
+
+  for (size_t i = 0; i < batch->last; ++i) {
+    const instr_t* instr = &program->code[i];
+    switch (instr->op) {
+      case OP_CONST:
+        scalars[top] = instr->as.value;
+        stack[top] = (operand_t) { &scalars[top], true };
+        ++top;
+        break;
+      case OP_LOAD:
+        if (batch->bindings[i] != NULL) {
+          stack[top] = (operand_t) { batch->bindings[i] + row, false };
+        } else {
+          scalars[top] = var_value(instr->as.var);
+          stack[top] = (operand_t) { &scalars[top], true };
+        }
+        ++top;
+        break;
+      case OP_NEG: {
+        operand_t* a = &stack[top - 1];
+        if (a->scalar) {
+          scalars[top - 1] = -*a->data;
+          a->data = &scalars[top - 1];
+        } else {
+          double* out = target(batch, results, row, i, top - 1);
+          kernels->neg(out, a->data, size);
+          a->data = out;
+        }
+        break;
+      }
+      case OP_STORE:
+        break;
+      case OP_CALL: {
+        const func_t* func = instr->as.func;
+        top -= func->arity;
+        operand_t* args = &stack[top];
+
+        // Impure functions are called for every row, even without columns
+        bool scalar = (func->flags & FUNC_PURE) != 0;
+        double values[FUNC_MAX_ARITY];
+        for (size_t j = 0; j < func->arity; ++j) {
+          scalar = scalar && args[j].scalar;
+          values[j] = *args[j].data;
+        }
+
+        if (scalar) {
+          scalars[top] = func_call(func, values);
+          stack[top] = (operand_t) { &scalars[top], true };
+        } else {
+          double* out = target(batch, results, row, i, top);
+          run_call(batch, func, args, top, out, size);
+          stack[top] = (operand_t) { out, false };
+        }
+        ++top;
+        break;
+      }
+      default: {
+        operand_t b = stack[--top];
+        operand_t* a = &stack[top - 1];
+        if (a->scalar && b.scalar) {
+          scalars[top - 1] = apply(instr->op, *a->data, *b.data);
+          a->data = &scalars[top - 1];
+          break;
+        }
+
+        double* out = target(batch, results, row, i, top - 1);
+        kernel_shape_t shape = a->scalar ? KERNEL_SV : b.scalar ? KERNEL_VS : KERNEL_VV;
+        kernels->binary[kernel_op(instr->op)][shape](out, a->data, b.data, size);
+        *a = (operand_t) { out, false };
+        break;
+      }
+    }
+  }
+
+  operand_t result = stack[0];
+  if (result.scalar) {
+    for (size_t i = 0; i < size; ++i)
+      results[row + i] = *result.data;
+  } else if (result.data != results + row) {
+    memmove(results + row, result.data, size * sizeof(double));
+  }
+}
+
+static void run_call(const batch_t* batch, const func_t* func, operand_t* args, size_t position, double* out, size_t size) {
+  kernel_unary_t unary = NULL;
+  kernel_binary_t binary = NULL;
+  if (func->kernel != KERNEL_NONE) {
+    unary = func->arity == 1 ? batch->kernels->unary_func[func->kernel] : NULL;
+    binary = func->arity == 2 ? batch->kernels->binary_func[func->kernel] : NULL;
+  }
+
+  if (unary != NULL || binary != NULL || func->vector != NULL) {
+    // The temporaries of scalar operands are free, so they are filled with
+    // copies of the scalar to run the vector versions
+    const double* columns[FUNC_MAX_ARITY];
+    for (size_t j = 0; j < func->arity; ++j) {
+      if (args[j].scalar) {
+        double* temp = batch->temps + (position + j) * BATCH_BLOCK;
+        for (size_t i = 0; i < size; ++i)
+          temp[i] = *args[j].data;
+        args[j].data = temp;
+      }
+      columns[j] = args[j].data;
+    }
+
+    if (unary != NULL) {
+      unary(out, columns[0], size);
+    } else if (binary != NULL) {
+      binary(out, columns[0], columns[1], size);
+    } else if (out == columns[0]) {
+      // A registered function gets results apart from its arguments, since
+      // it may write some of them before it has read all of its arguments
+      double* spare = batch->temps + (batch->program->depth + 1) * BATCH_BLOCK;
+      func->vector(spare, columns, size);
+      memcpy(out, spare, size * sizeof(double));
+    } else {
+      func->vector(out, columns, size);
+    }
+    return;
+  }
+
+  double values[FUNC_MAX_ARITY];
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t j = 0; j < func->arity; ++j)
+      values[j] = args[j].scalar ? *args[j].data : args[j].data[i];
+    out[i] = func_call(func, values);
+  }
+}
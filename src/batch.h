@@ -0,0 +1,34 @@
+/* Batch - Columnar evaluation of compiled programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_BATCH_H
+#define ARITHMO_BATCH_H
+
+#include <stddef.h>
+
+#include "arithmo.h"
+#include "program.h"
+
+extern artm_result_t batch_run(
+  const program_t* program,
+  const artm_column_t* columns, size_t count,
+  double* results, size_t rows
+);
+
+#endif // ARITHMO_BATCH_H
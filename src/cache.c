@@ -0,0 +1,310 @@
+/* Cache - Bounded LRU cache of compiled expressions
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "cache.h"
+
+// Small caches keep a single shard, since every shard holds its own share
+// of the capacity and a busy shard can't borrow from an idle one
+#define CACHE_MAX_SHARDS 16
+#define CACHE_MIN_SHARD_CAPACITY 16
+
+// A text has to come back within a few times the capacity of new texts to
+// be compiled, since one that comes back later would have been evicted
+#define CACHE_SEEN_WINDOW 4
+#define CACHE_SEEN_BITS_PER_TEXT 64
+
+static cache_shard_t* shard_of(const cache_t* cache, uint64_t hash);
+static bool has_bits(_Atomic uint64_t* seen, size_t first, size_t second);
+static void set_bits(_Atomic uint64_t* seen, size_t first, size_t second);
+static void evict(cache_shard_t* shard);
+static void unlink_entry(cache_shard_t* shard, cache_entry_t* entry);
+static void push_front(cache_shard_t* shard, cache_entry_t* entry);
+static void free_entry(cache_entry_t* entry);
+
+// A cache that can't get its shards is simply disabled
+extern void cache_init(cache_t* cache, size_t capacity, const artm_allocator_t* allocator) {
+  cache->allocator = allocator;
+  cache->shards = NULL;
+  cache->seen = NULL;
+  cache->mask = cache->seen_mask = 0;
+  cache->capacity = 0;
+  if (capacity == 0)
+    return;
+
+  size_t shards = 1;
+  while (shards < CACHE_MAX_SHARDS && shards * 2 * CACHE_MIN_SHARD_CAPACITY <= capacity)
+    shards *= 2;
+
+  size_t seen = 1;
+  while (seen * 64 < capacity * CACHE_SEEN_WINDOW * CACHE_SEEN_BITS_PER_TEXT)
+    seen *= 2;
+
+  cache->shards = (cache_shard_t*) alloc_new(allocator, shards * sizeof(cache_shard_t));
+  cache->seen = (_Atomic uint64_t*) alloc_new(allocator, 2 * seen * sizeof(uint64_t));
+  if (cache->shards == NULL || cache->seen == NULL) {
+    alloc_free(allocator, cache->shards);
+    alloc_free(allocator, (void*) cache->seen);
+    cache->shards = NULL;
+    cache->seen = NULL;
+    return;
+  }
+
+  for (size_t i = 0; i < 2 * seen; ++i)
+    atomic_init(&cache->seen[i], 0);
+  atomic_init(&cache->seen_current, 0);
+  atomic_init(&cache->seen_count, 0);
+
+  for (size_t i = 0; i < shards; ++i) {
+    cache_shard_t* shard = &cache->shards[i];
+    shard->capacity = capacity / shards + (i < capacity % shards);
+    table_init(&shard->index, shard->capacity, allocator);
+    shard->head = shard->tail = NULL;
+    shard->size = shard->evictions = 0;
+    shard->hits = 0;
+    atomic_init(&shard->misses, 0);
+    pthread_mutex_init(&shard->lock, NULL);
+  }
+
+  cache->mask = shards - 1;
+  cache->seen_mask = seen - 1;
+  cache->capacity = capacity;
+}
+
+extern void cache_free(cache_t* cache) {
+  if (cache->shards == NULL)
+    return;
+
+  for (size_t i = 0; i <= cache->mask; ++i) {
+    cache_shard_t* shard = &cache->shards[i];
+    while (shard->head != NULL) {
+      cache_entry_t* entry = shard->head;
+      shard->head = entry->next;
+      cache_release(entry);
+    }
+
+    pthread_mutex_destroy(&shard->lock);
+    table_free(&shard->index);
+  }
+
+  alloc_free(cache->allocator, cache->shards);
+  alloc_free(cache->allocator, (void*) cache->seen);
+}
+
+// The returned entry stays valid until cache_release, even if it gets evicted
+extern cache_entry_t* cache_get(cache_t* cache, uint64_t hash, const char* source, size_t size) {
+  if (cache->capacity == 0)
+    return NULL;
+
+  cache_shard_t* shard = shard_of(cache, hash);
+  pthread_mutex_lock(&shard->lock);
+  cache_entry_t* entry = (cache_entry_t*) table_get_hashed(&shard->index, source, size, hash).as.ptr;
+  if (entry != NULL) {
+    ++shard->hits;
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    atomic_store_explicit(&entry->referenced, true, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  if (entry == NULL)
+    atomic_fetch_add_explicit(&shard->misses, 1, memory_order_relaxed);
+  return entry;
+}
+
+// A text is only looked up and compiled once it was seen before, so the
+// ones that never repeat don't touch the shards. After each window of new
+// texts the older generation of bits is cleared and becomes the current
+// one; a text that comes back from the previous one is copied over, so the
+// ones that keep coming back never look new. Two texts that share their
+// bits only get in early. The bits are hints, so threads that race on them
+// only let a text in too early or too late
+extern bool cache_seen(cache_t* cache, uint64_t hash) {
+  size_t words = cache->seen_mask + 1;
+  size_t first = (size_t) (hash >> 32) & (words * 64 - 1);
+  size_t second = (size_t) (hash >> 8) & (words * 64 - 1);
+  size_t current = atomic_load_explicit(&cache->seen_current, memory_order_relaxed);
+  _Atomic uint64_t* now = cache->seen + current * words;
+  _Atomic uint64_t* before = cache->seen + (current ^ 1) * words;
+  if (has_bits(now, first, second))
+    return true;
+
+  set_bits(now, first, second);
+  if (has_bits(before, first, second))
+    return true;
+
+  atomic_fetch_add_explicit(&shard_of(cache, hash)->misses, 1, memory_order_relaxed);
+  size_t count = atomic_load_explicit(&cache->seen_count, memory_order_relaxed) + 1;
+  if (count >= cache->capacity * CACHE_SEEN_WINDOW) {
+    for (size_t i = 0; i < words; ++i)
+      atomic_store_explicit(&before[i], 0, memory_order_relaxed);
+    atomic_store_explicit(&cache->seen_current, current ^ 1, memory_order_relaxed);
+    count = 0;
+  }
+  atomic_store_explicit(&cache->seen_count, count, memory_order_relaxed);
+  return false;
+}
+
+// Takes over the entry and returns the one that ends up cached for its text,
+// which differs if another thread got there first
+extern cache_entry_t* cache_put(cache_t* cache, cache_entry_t* entry) {
+  cache_shard_t* shard = shard_of(cache, entry->hash);
+  pthread_mutex_lock(&shard->lock);
+  cache_entry_t* cached = (cache_entry_t*) table_get_hashed(&shard->index, entry->source, entry->size, entry->hash).as.ptr;
+  if (cached != NULL) {
+    atomic_fetch_add_explicit(&cached->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&shard->lock);
+    free_entry(entry);
+    return cached;
+  }
+
+  if (!table_put(&shard->index, entry->source, entry->size, TABLE_PTR_VALUE(entry))) {
+    pthread_mutex_unlock(&shard->lock);
+    return entry;
+  }
+
+  // One reference for the cache and one for the caller. The text was seen
+  // twice already, so it gets a second chance like an entry that was hit
+  atomic_store_explicit(&entry->refs, 2, memory_order_relaxed);
+  atomic_store_explicit(&entry->referenced, true, memory_order_relaxed);
+  push_front(shard, entry);
+  if (++shard->size > shard->capacity)
+    evict(shard);
+  pthread_mutex_unlock(&shard->lock);
+  return entry;
+}
+
+extern void cache_release(cache_entry_t* entry) {
+  if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1)
+    free_entry(entry);
+}
+
+extern void cache_stats(cache_t* cache, artm_cache_stats_t* stats) {
+  stats->hits = stats->misses = stats->evictions = stats->size = 0;
+  stats->capacity = cache->capacity;
+  for (size_t i = 0; cache->shards != NULL && i <= cache->mask; ++i) {
+    cache_shard_t* shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    stats->hits += shard->hits;
+    stats->misses += atomic_load_explicit(&shard->misses, memory_order_relaxed);
+    stats->evictions += shard->evictions;
+    stats->size += shard->size;
+    pthread_mutex_unlock(&shard->lock);
+  }
+}
+
+// Entries that are still in use are freed by their last cache_release
+extern void cache_clear(cache_t* cache) {
+  for (size_t i = 0; cache->shards != NULL && i <= cache->mask; ++i) {
+    cache_shard_t* shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    while (shard->head != NULL) {
+      cache_entry_t* entry = shard->head;
+      unlink_entry(shard, entry);
+      table_remove(&shard->index, entry->source, entry->size);
+      cache_release(entry);
+    }
+    shard->size = 0;
+    pthread_mutex_unlock(&shard->lock);
+  }
+}
+
+// The entry keeps its own copy of the text, which its tokens point into,
+// right after itself in the same allocation
+extern cache_entry_t* cache_entry_new(const cache_t* cache, uint64_t hash, const char* source, size_t size) {
+  cache_entry_t* entry = (cache_entry_t*) alloc_new(cache->allocator, sizeof(cache_entry_t) + size + 1);
+  if (entry == NULL)
+    return NULL;
+
+  entry->source = (char*) (entry + 1);
+  memcpy(entry->source, source, size);
+  entry->source[size] = '\0';
+  entry->size = size;
+  entry->hash = hash;
+  entry->declaration = false;
+  entry->prev = entry->next = NULL;
+  atomic_init(&entry->referenced, false);
+  atomic_init(&entry->refs, 1);
+  program_init(&entry->program, cache->allocator);
+  return entry;
+}
+
+// The top bits, since the index of the shard's table uses the low ones
+static cache_shard_t* shard_of(const cache_t* cache, uint64_t hash) {
+  return &cache->shards[(hash >> 56) & cache->mask];
+}
+
+static bool has_bits(_Atomic uint64_t* seen, size_t first, size_t second) {
+  return (atomic_load_explicit(&seen[first / 64], memory_order_relaxed) & ((uint64_t) 1 << (first % 64)))
+    && (atomic_load_explicit(&seen[second / 64], memory_order_relaxed) & ((uint64_t) 1 << (second % 64)));
+}
+
+// Plain stores instead of atomic ors: a bit lost to another thread only
+// makes its text look new once more
+static void set_bits(_Atomic uint64_t* seen, size_t first, size_t second) {
+  uint64_t word = atomic_load_explicit(&seen[first / 64], memory_order_relaxed);
+  atomic_store_explicit(&seen[first / 64], word | ((uint64_t) 1 << (first % 64)), memory_order_relaxed);
+  word = atomic_load_explicit(&seen[second / 64], memory_order_relaxed);
+  atomic_store_explicit(&seen[second / 64], word | ((uint64_t) 1 << (second % 64)), memory_order_relaxed);
+}
+
+// Second chance: the oldest entries that were hit since they were last
+// looked at go back to the front, and the first one that wasn't goes away
+static void evict(cache_shard_t* shard) {
+  for (;;) {
+    cache_entry_t* victim = shard->tail;
+    unlink_entry(shard, victim);
+    if (atomic_exchange_explicit(&victim->referenced, false, memory_order_relaxed)) {
+      push_front(shard, victim);
+      continue;
+    }
+
+    table_remove(&shard->index, victim->source, victim->size);
+    --shard->size;
+    ++shard->evictions;
+    cache_release(victim);
+    return;
+  }
+}
+
+static void unlink_entry(cache_shard_t* shard, cache_entry_t* entry) {
+  if (entry->prev != NULL) entry->prev->next = entry->next;
+  else shard->head = entry->next;
+
+  if (entry->next != NULL) entry->next->prev = entry->prev;
+  else shard->tail = entry->prev;
+
+  entry->prev = entry->next = NULL;
+}
+
+static void push_front(cache_shard_t* shard, cache_entry_t* entry) {
+  entry->prev = NULL;
+  entry->next = shard->head;
+  if (shard->head != NULL) shard->head->prev = entry;
+  else shard->tail = entry;
+  shard->head = entry;
+}
+
+// Entries don't point back to their cache, so the allocator comes from the program
+static void free_entry(cache_entry_t* entry) {
+  const artm_allocator_t* allocator = entry->program.allocator;
+  program_free(&entry->program);
+  alloc_free(allocator, entry);
+}
@@ -0,0 +1,89 @@
+/* Cache - Bounded LRU cache of compiled expressions
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_CACHE_H
+#define ARITHMO_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "arithmo.h"
+#include "table.h"
+#include "program.h"
+
+typedef struct cache cache_t;
+typedef struct cache_shard cache_shard_t;
+typedef struct cache_entry cache_entry_t;
+
+struct cache_entry {
+  cache_entry_t* prev;
+  cache_entry_t* next;
+  char* source;
+  size_t size;
+  uint64_t hash;
+  bool declaration;
+  atomic_bool referenced;
+  atomic_size_t refs;
+  program_t program;
+};
+
+// A hit only holds the lock of its shard to find the entry and mark it, so
+// readers of texts in different shards never wait for each other. Misses
+// are also counted without the lock, by cache_seen
+struct cache_shard {
+  table_t index;
+  cache_entry_t* head;
+  cache_entry_t* tail;
+  size_t size;
+  size_t capacity;
+  size_t hits;
+  atomic_size_t misses;
+  size_t evictions;
+  pthread_mutex_t lock;
+};
+
+// The texts that missed recently are remembered by two bits each, in the
+// current and the previous of two generations of seen
+struct cache {
+  cache_shard_t* shards;
+  size_t mask;
+  _Atomic uint64_t* seen;
+  size_t seen_mask;
+  atomic_size_t seen_current;
+  atomic_size_t seen_count;
+  size_t capacity;
+  const artm_allocator_t* allocator;
+};
+
+extern void cache_init(cache_t* cache, size_t capacity, const artm_allocator_t* allocator);
+extern void cache_free(cache_t* cache);
+
+extern cache_entry_t* cache_get(cache_t* cache, uint64_t hash, const char* source, size_t size);
+extern bool cache_seen(cache_t* cache, uint64_t hash);
+extern cache_entry_t* cache_put(cache_t* cache, cache_entry_t* entry);
+extern void cache_release(cache_entry_t* entry);
+extern void cache_stats(cache_t* cache, artm_cache_stats_t* stats);
+extern void cache_clear(cache_t* cache);
+
+extern cache_entry_t* cache_entry_new(const cache_t* cache, uint64_t hash, const char* source, size_t size);
+
+#endif // ARITHMO_CACHE_H
@@ -0,0 +1,152 @@
+/* Calc - Arithmo Interpreter internals
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_CALC_H
+#define ARITHMO_CALC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "arithmo.h"
+#include "alloc.h"
+#include "store.h"
+#include "table.h"
+#include "parser.h"
+#include "pool.h"
+#include "program.h"
+#include "jit.h"
+#include "cache.h"
+#include "stats.h"
+
+#define CALC_CACHE_CAPACITY 64
+#define CALC_CACHE_MAX_SIZE 4096
+
+// The value and the defined flag are read without locks while the writer
+// stores them (the JIT loads the value from offset 0)
+struct artm_var {
+  _Atomic double value;
+  atomic_bool defined;
+  bool constant;
+  bool dirty;
+  bool queued;
+  char* name;
+  artm_calc_t* calc;
+  struct formula* formula;
+  artm_var_t next_dirty;
+  artm_var_t next_work;
+  size_t cursor;
+  size_t mark;
+  struct {
+    artm_var_t* items;
+    size_t count;
+    size_t capacity;
+  } dependents;
+};
+
+// The variables and registered functions live in the arena, everything
+// else comes from the allocator. A fork only holds its overrides, and the
+// names it doesn't have are looked up in the parent
+struct artm_calc {
+  artm_allocator_t allocator;
+  arena_t arena;
+  parser_spare_t spare;
+  artm_calc_t* parent;
+  store_t decls;
+  table_t funcs;
+  cache_t cache;
+  pthread_mutex_t lock;
+  pool_t* pool;
+  artm_var_t dirty;
+  size_t mark;
+  size_t max_depth;
+  atomic_size_t version;
+  size_t writing;
+  STATS(stats_t stats;)
+};
+
+// A loaded expression is packed: its program and source live in the
+// same allocation as the expression itself
+struct artm_expr {
+  artm_calc_t* calc;
+  char* source;
+  program_t program;
+  jit_t jit;
+  bool packed;
+};
+
+// A compiled script has one program per statement, run in order
+struct artm_script {
+  artm_calc_t* calc;
+  char* source;
+  program_t* statements;
+  size_t count;
+};
+
+typedef struct dag_node dag_node_t;
+
+// A node of a formula set; the operands always come before the node (the
+// ones of a call are the arity ids from args + a)
+struct dag_node {
+  opcode_t op;
+  size_t a;
+  size_t b;
+  union {
+    double value;
+    artm_var_t var;
+    const func_t* func;
+  } as;
+};
+
+struct artm_exprset {
+  artm_calc_t* calc;
+  dag_node_t* nodes;
+  size_t size;
+  size_t* args;
+  size_t args_size;
+  size_t* roots;
+  artm_expr_t** exprs;
+  size_t count;
+  size_t total;
+};
+
+// The value is stored before the flag and loaded after it, so a reader
+// that sees a defined variable also sees its value. The orderings of the
+// value itself are the ones of the versions of artm_calc_read_retry
+static inline bool var_defined(const struct artm_var* var) {
+  return atomic_load_explicit(&var->defined, memory_order_acquire);
+}
+
+static inline double var_value(const struct artm_var* var) {
+  return atomic_load_explicit(&var->value, memory_order_acquire);
+}
+
+static inline void var_store(struct artm_var* var, double value) {
+  atomic_store_explicit(&var->value, value, memory_order_release);
+  atomic_store_explicit(&var->defined, true, memory_order_release);
+}
+
+extern artm_result_t calc_eval(artm_calc_t* calc, const char* expression, size_t size, bool readonly);
+extern artm_result_t calc_statement(parser_t* parser, bool readonly);
+extern artm_var_t calc_find(const artm_calc_t* calc, const char* name, size_t size);
+extern artm_var_t calc_resolve(artm_calc_t* calc, const char* name, size_t size);
+extern const func_t* calc_func(const artm_calc_t* calc, const char* name, size_t size);
+
+#endif // ARITHMO_CALC_H
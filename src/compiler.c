@@ -0,0 +1,77 @@
+/* Compiler - Math expression to bytecode compiler
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+
+#include "calc.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "result.h"
+
+static artm_result_t compile_program(parser_t* comp);
+static artm_result_t compile_decl(parser_t* comp);
+
+extern artm_result_t compile(artm_calc_t* calc, program_t* program, const char* expression, size_t size, bool resolve) {
+  parser_t comp;
+  parser_init(&comp, calc, expression, size);
+  comp.program = program;
+  comp.resolve = resolve;
+  artm_result_t result = compile_program(&comp);
+  STATS(stats_add(&calc->stats.tokens, comp.lexer.tokens);)
+  parser_free(&comp);
+  return result;
+}
+
+static artm_result_t compile_program(parser_t* comp) {
+  comp->token = lexer_next(&comp->lexer);
+  if (parser_check(comp, TKN_END)) {
+    instr_t instr = { .op = OP_CONST, .as = { .value = 0 } };
+    if (!program_emit(comp->program, instr, comp->token)) {
+      return ARTM_ERROR(ARTM_ALLOC_ERR, comp->token);
+    }
+    return ARTM_VALUE(0);
+  }
+  return compile_statement(comp);
+}
+
+extern artm_result_t compile_statement(parser_t* comp) {
+  switch (comp->token.type) {
+    case TKN_ERROR:
+      return ARTM_ERROR(ARTM_INV_TOKEN, comp->token);
+    case TKN_DOLLAR:
+      return compile_decl(comp);
+    default:
+      return parser_expr(comp);
+  }
+}
+
+static artm_result_t compile_decl(parser_t* comp) {
+  PARSER_ADVANCE(comp);
+
+  token_t id = comp->token;
+
+  PARSER_CONSUME(comp, TKN_ID, ARTM_INV_TOKEN);
+  PARSER_CONSUME(comp, TKN_EQUAL, ARTM_INV_TOKEN);
+
+  artm_result_t result = parser_expr(comp);
+  ARTM_CHECK_RESULT(result);
+
+  return parser_emit_named(comp, OP_STORE, id);
+}
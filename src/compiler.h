@@ -0,0 +1,33 @@
+/* Compiler - Math expression to bytecode compiler
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_COMPILER_H
+#define ARITHMO_COMPILER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "arithmo.h"
+#include "parser.h"
+#include "program.h"
+
+extern artm_result_t compile(artm_calc_t* calc, program_t* program, const char* expression, size_t size, bool resolve);
+extern artm_result_t compile_statement(parser_t* comp);
+
+#endif // ARITHMO_COMPILER_H
@@ -0,0 +1,209 @@
+/* Expr - Compiled math expressions
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "arithmo.h"
+#include "alloc.h"
+#include "batch.h"
+#include "calc.h"
+#include "compiler.h"
+#include "jit.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "result.h"
+#include "tangent.h"
+
+static inline void set_error(artm_result_t* error, artm_result_t result) {
+  if (error != NULL) {
+    *error = result;
+  }
+}
+
+static inline bool valid_vars(const artm_var_t* vars, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (vars[i] == NULL)
+      return false;
+  }
+  return true;
+}
+
+extern artm_expr_t* artm_calc_compile(artm_calc_t* calc, const char* expression, artm_result_t* error) {
+  return artm_calc_compile_ex(calc, expression, ARTM_OPT_DEFAULT, error);
+}
+
+extern artm_expr_t* artm_calc_compile_ex(artm_calc_t* calc, const char* expression, unsigned flags, artm_result_t* error) {
+  if (calc == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_NULL_CALC, (token_t) { 0 }));
+    return NULL;
+  }
+
+  if (expression == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  artm_expr_t* expr = (artm_expr_t*) alloc_new(&calc->allocator, sizeof(artm_expr_t));
+  if (expr == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  expr->calc = calc;
+  expr->packed = false;
+  expr->source = alloc_strndup(&calc->allocator, expression, strlen(expression));
+  program_init(&expr->program, &calc->allocator);
+  jit_init(&expr->jit);
+  if (expr->source == NULL) {
+    alloc_free(&calc->allocator, expr);
+    set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  artm_result_t result = compile(calc, &expr->program, expr->source, strlen(expr->source), true);
+  if (result.status != ARTM_SUCCESS) {
+    // Point the error token back into the caller's text
+    if (result.as.token.target != NULL)
+      result.as.token.target = expression + (result.as.token.target - expr->source);
+    set_error(error, result);
+    artm_expr_free(expr);
+    return NULL;
+  }
+
+  if ((flags & ARTM_OPT_FOLD) && !optimize(&expr->program, flags)) {
+    set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+    artm_expr_free(expr);
+    return NULL;
+  }
+
+  // Expressions that can't be translated keep running on the interpreter
+  if (flags & ARTM_OPT_JIT)
+    jit_compile(&expr->jit, &expr->program);
+
+  set_error(error, result);
+  return expr;
+}
+
+extern artm_result_t artm_expr_eval(const artm_expr_t* expr) {
+  if (expr == NULL) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+  STATS(uint64_t start = stats_start(&expr->calc->stats);)
+  artm_result_t result = expr->jit.code != NULL
+    ? jit_run(&expr->jit, &expr->program)
+    : program_run(&expr->program);
+  STATS(stats_eval(&expr->calc->stats, result.status, start);)
+  return result;
+}
+
+extern double artm_expr_cbk_eval(const artm_expr_t* expr, artm_cbk_t cbk) {
+  artm_result_t result = artm_expr_eval(expr);
+  if (result.status == ARTM_SUCCESS)
+    return result.as.value;
+
+  cbk.target(&result, cbk.payload);
+  return 0;
+}
+
+extern artm_result_t artm_expr_eval_batch(
+  const artm_expr_t* expr,
+  const artm_column_t* columns, size_t count,
+  double* results, size_t rows
+) {
+  if (expr == NULL) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+  return batch_run(&expr->program, columns, count, results, rows);
+}
+
+extern artm_result_t artm_expr_eval_grad(const artm_expr_t* expr, const artm_var_t* vars, size_t count, double* gradient) {
+  return artm_expr_eval_tangents(expr, vars, count, NULL, count, gradient);
+}
+
+extern artm_result_t artm_expr_eval_tangents(
+  const artm_expr_t* expr,
+  const artm_var_t* vars, size_t count,
+  const double* seeds, size_t directions,
+  double* derivatives
+) {
+  if (expr == NULL) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+
+  if ((vars == NULL && count > 0) || (derivatives == NULL && directions > 0) || !valid_vars(vars, count)) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+
+  STATS(uint64_t start = stats_start(&expr->calc->stats);)
+  artm_result_t result = tangent_run(&expr->program, vars, count, seeds, directions, derivatives);
+  STATS(stats_eval(&expr->calc->stats, result.status, start);)
+  return result;
+}
+
+// The expression is compiled for this call only, and like the other readers
+// it never declares (or creates) variables
+extern artm_result_t artm_calc_eval_grad(
+  artm_calc_t* calc, const char* expression,
+  const artm_var_t* vars, size_t count,
+  double* gradient
+) {
+  if (calc == NULL) {
+    return ARTM_ERROR(ARTM_NULL_CALC, (token_t) { 0 });
+  }
+
+  if (expression == NULL || (vars == NULL && count > 0) || (gradient == NULL && count > 0) || !valid_vars(vars, count)) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+
+  size_t size = strlen(expression);
+  lexer_t lexer;
+  lexer_init(&lexer, expression, size);
+  token_t first = lexer_next(&lexer);
+  if (first.type == TKN_DOLLAR) {
+    return ARTM_ERROR(ARTM_READ_ONLY, first);
+  }
+
+  STATS(uint64_t start = stats_start(&calc->stats);)
+  program_t program;
+  program_init(&program, &calc->allocator);
+  artm_result_t result = compile(calc, &program, expression, size, false);
+  if (result.status == ARTM_SUCCESS)
+    result = tangent_run(&program, vars, count, NULL, count, gradient);
+  program_free(&program);
+  STATS(stats_eval(&calc->stats, result.status, start);)
+  return result;
+}
+
+extern void artm_expr_dump(const artm_expr_t* expr, FILE* stream) {
+  if (expr != NULL && stream != NULL) {
+    program_dump(&expr->program, stream);
+  }
+}
+
+extern void artm_expr_free(artm_expr_t* expr) {
+  if (expr != NULL) {
+    const artm_allocator_t* allocator = &expr->calc->allocator;
+    jit_free(&expr->jit);
+    if (!expr->packed) {
+      program_free(&expr->program);
+      alloc_free(allocator, expr->source);
+    }
+    alloc_free(allocator, expr);
+  }
+}
@@ -0,0 +1,316 @@
+/* Expr set - Formula sets sharing their common sub-expressions
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "arithmo.h"
+#include "alloc.h"
+#include "calc.h"
+#include "func.h"
+#include "graph.h"
+#include "result.h"
+#include "table.h"
+
+// Sets with more unique nodes evaluate into an allocated buffer
+#define EXPRSET_STACK_NODES 512
+
+typedef struct dag_key dag_key_t;
+
+// The bytes that identify a node; equal keys compute equal values. Only
+// the ids of the arguments of a call are used, not their position in args
+struct dag_key {
+  uint64_t op;
+  uint64_t a;
+  uint64_t b;
+  uint64_t bits;
+  uint64_t args[FUNC_MAX_ARITY];
+};
+
+static bool build(artm_exprset_t* set, table_t* index, size_t formula);
+static bool intern(artm_exprset_t* set, table_t* index, dag_node_t node, const size_t* args, size_t* id);
+
+static inline void set_error(artm_result_t* error, artm_result_t result) {
+  if (error != NULL) {
+    *error = result;
+  }
+}
+
+// Returns the size of the key in bytes
+static inline size_t key_of(const dag_node_t* node, const size_t* args, dag_key_t* key) {
+  *key = (dag_key_t) { .op = (uint64_t) node->op, .a = node->a, .b = node->b };
+  switch (node->op) {
+    case OP_CONST:
+      memcpy(&key->bits, &node->as.value, sizeof(double));
+      break;
+    case OP_LOAD:
+      key->bits = (uint64_t) (uintptr_t) node->as.var;
+      break;
+    case OP_CALL:
+      key->bits = (uint64_t) (uintptr_t) node->as.func;
+      for (size_t i = 0; i < node->as.func->arity; ++i)
+        key->args[i] = args[i];
+      return offsetof(dag_key_t, args) + node->as.func->arity * sizeof(uint64_t);
+    default: break;
+  }
+  return offsetof(dag_key_t, args);
+}
+
+extern artm_exprset_t* artm_calc_compile_set(
+  artm_calc_t* calc,
+  const char* const* expressions, size_t count,
+  artm_result_t* error
+) {
+  if (calc == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_NULL_CALC, (token_t) { 0 }));
+    return NULL;
+  }
+
+  if (expressions == NULL && count > 0) {
+    set_error(error, ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  const artm_allocator_t* allocator = &calc->allocator;
+  artm_exprset_t* set = (artm_exprset_t*) alloc_zeroed(allocator, 1, sizeof(artm_exprset_t));
+  if (set == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  set->calc = calc;
+  set->count = count;
+  set->roots = (size_t*) alloc_new(allocator, (count > 0 ? count : 1) * sizeof(size_t));
+  set->exprs = (artm_expr_t**) alloc_zeroed(allocator, count > 0 ? count : 1, sizeof(artm_expr_t*));
+  if (set->roots == NULL || set->exprs == NULL) {
+    artm_exprset_free(set);
+    set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    artm_result_t result;
+    set->exprs[i] = artm_calc_compile(calc, expressions[i], &result);
+    if (set->exprs[i] == NULL) {
+      artm_exprset_free(set);
+      set_error(error, result);
+      return NULL;
+    }
+
+    // Every formula of the set is evaluated as a reader
+    const program_t* program = &set->exprs[i]->program;
+    if (program->code[program->size - 1].op == OP_STORE) {
+      token_t token = program->tokens[program->size - 1];
+      token.target = expressions[i] + (token.target - set->exprs[i]->source);
+      artm_exprset_free(set);
+      set_error(error, ARTM_ERROR(ARTM_READ_ONLY, token));
+      return NULL;
+    }
+    set->total += program->size;
+  }
+
+  table_t index;
+  table_init(&index, set->total, allocator);
+  for (size_t i = 0; i < count; ++i) {
+    if (!build(set, &index, i)) {
+      table_free(&index);
+      artm_exprset_free(set);
+      set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+      return NULL;
+    }
+  }
+  table_free(&index);
+
+  set_error(error, ARTM_VALUE(0));
+  return set;
+}
+
+extern artm_status_t artm_exprset_eval(const artm_exprset_t* set, artm_result_t* results) {
+  if (set == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+  if (set->count == 0) {
+    return ARTM_SUCCESS;
+  }
+
+  // Most sets fit on the stack, so their evaluation doesn't allocate
+  double buffer[EXPRSET_STACK_NODES];
+  double* values = set->size <= EXPRSET_STACK_NODES
+    ? buffer
+    : (double*) alloc_new(&set->calc->allocator, set->size * sizeof(double));
+  if (values == NULL) {
+    return ARTM_ALLOC_ERR;
+  }
+
+  bool undefined = false;
+  for (size_t i = 0; i < set->size; ++i) {
+    const dag_node_t* node = &set->nodes[i];
+    switch (node->op) {
+      case OP_CONST:
+        values[i] = node->as.value;
+        break;
+      case OP_LOAD:
+        if (!var_defined(node->as.var)) {
+          undefined = true;
+          values[i] = 0;
+          break;
+        }
+        if (node->as.var->dirty)
+          graph_update(node->as.var);
+        values[i] = var_value(node->as.var);
+        break;
+      case OP_NEG:
+        values[i] = -values[node->a];
+        break;
+      case OP_ADD:
+        values[i] = values[node->a] + values[node->b];
+        break;
+      case OP_SUB:
+        values[i] = values[node->a] - values[node->b];
+        break;
+      case OP_MUL:
+        values[i] = values[node->a] * values[node->b];
+        break;
+      case OP_DIV:
+        values[i] = values[node->a] / values[node->b];
+        break;
+      case OP_CALL: {
+        double args[FUNC_MAX_ARITY];
+        for (size_t j = 0; j < node->as.func->arity; ++j)
+          args[j] = values[set->args[node->a + j]];
+        values[i] = func_call(node->as.func, args);
+        break;
+      }
+      default: break;
+    }
+  }
+
+  for (size_t i = 0; i < set->count; ++i)
+    results[i] = ARTM_VALUE(values[set->roots[i]]);
+  if (values != buffer)
+    alloc_free(&set->calc->allocator, values);
+
+  // Only the formulas' own programs know which token read the undefined
+  // variable, so the failed pass is repeated one formula at a time
+  artm_status_t status = ARTM_SUCCESS;
+  if (undefined) {
+    for (size_t i = 0; i < set->count; ++i) {
+      results[i] = program_run(&set->exprs[i]->program);
+      if (results[i].status != ARTM_SUCCESS)
+        status = results[i].status;
+    }
+  }
+  return status;
+}
+
+extern void artm_exprset_stats(const artm_exprset_t* set, artm_exprset_stats_t* stats) {
+  if (set == NULL || stats == NULL)
+    return;
+
+  stats->formulas = set->count;
+  stats->nodes = set->total;
+  stats->unique_nodes = set->size;
+  stats->shared_nodes = set->total - set->size;
+}
+
+extern void artm_exprset_free(artm_exprset_t* set) {
+  if (set != NULL) {
+    const artm_allocator_t* allocator = &set->calc->allocator;
+    if (set->exprs != NULL) {
+      for (size_t i = 0; i < set->count; ++i)
+        artm_expr_free(set->exprs[i]);
+    }
+    alloc_free(allocator, set->exprs);
+    alloc_free(allocator, set->roots);
+    alloc_free(allocator, set->nodes);
+    alloc_free(allocator, set->args);
+    alloc_free(allocator, set);
+  }
+}
+
+// Replays the formula's postfix program on a stack of node ids
+static bool build(artm_exprset_t* set, table_t* index, size_t formula) {
+  const program_t* program = &set->exprs[formula]->program;
+  size_t stack[program->depth + 1];
+  size_t top = 0;
+
+  for (size_t i = 0; i < program->size; ++i) {
+    const instr_t* instr = &program->code[i];
+    dag_node_t node = { .op = instr->op };
+    const size_t* args = NULL;
+    switch (instr->op) {
+      case OP_CONST:
+        node.as.value = instr->as.value;
+        break;
+      case OP_LOAD:
+        node.as.var = instr->as.var;
+        break;
+      case OP_NEG:
+        node.a = stack[--top];
+        break;
+      case OP_CALL:
+        node.as.func = instr->as.func;
+        top -= instr->as.func->arity;
+        args = &stack[top];
+        break;
+      default:
+        node.b = stack[--top];
+        node.a = stack[--top];
+        break;
+    }
+    if (!intern(set, index, node, args, &stack[top++]))
+      return false;
+  }
+
+  set->roots[formula] = stack[top - 1];
+  return true;
+}
+
+static bool intern(artm_exprset_t* set, table_t* index, dag_node_t node, const size_t* args, size_t* id) {
+  // Every call of an impure function is a node of its own
+  dag_key_t key;
+  size_t size = key_of(&node, args, &key);
+  bool shared = node.op != OP_CALL || (node.as.func->flags & FUNC_PURE) != 0;
+  table_value_t found = shared ? table_get(index, (const char*) &key, size) : TABLE_PTR_VALUE(NULL);
+  if (found.type == TAB_VAL_DBL) {
+    *id = (size_t) found.as.dbl;
+    return true;
+  }
+
+  // The set never has more nodes (or call arguments) than the formulas
+  // have instructions
+  if (set->nodes == NULL) {
+    set->nodes = (dag_node_t*) alloc_new(&set->calc->allocator, set->total * sizeof(dag_node_t));
+    set->args = (size_t*) alloc_new(&set->calc->allocator, set->total * sizeof(size_t));
+    if (set->nodes == NULL || set->args == NULL)
+      return false;
+  }
+
+  if (shared && !table_put(index, (const char*) &key, size, TABLE_DBL_VALUE((double) set->size)))
+    return false;
+
+  if (node.op == OP_CALL) {
+    node.a = set->args_size;
+    for (size_t i = 0; i < node.as.func->arity; ++i)
+      set->args[set->args_size++] = args[i];
+  }
+  set->nodes[set->size] = node;
+  *id = set->size++;
+  return true;
+}
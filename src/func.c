@@ -0,0 +1,157 @@
+/* Func - Built-in math functions
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "func.h"
+
+#define FUNC_UNARY(_name_, _func_, _kernel_, _derivative_) \
+  { \
+    .name = _name_, .arity = 1, .flags = FUNC_PURE, .kind = FUNC_UNARY, .kernel = _kernel_, \
+    .as = { .unary = _func_ }, .derivative = { .unary = _derivative_ } \
+  }
+
+#define FUNC_BINARY(_name_, _func_, _kernel_, _derivative_) \
+  { \
+    .name = _name_, .arity = 2, .flags = FUNC_PURE, .kind = FUNC_BINARY, .kernel = _kernel_, \
+    .as = { .binary = _func_ }, .derivative = { .binary = _derivative_ } \
+  }
+
+static double d_abs(double x) { return x > 0 ? 1 : x < 0 ? -1 : 0; }
+static double d_acos(double x) { return -1 / sqrt(1 - x * x); }
+static double d_asin(double x) { return 1 / sqrt(1 - x * x); }
+static double d_atan(double x) { return 1 / (1 + x * x); }
+static double d_cbrt(double x) { return 1 / (3 * cbrt(x) * cbrt(x)); }
+static double d_cosh(double x) { return sinh(x); }
+static double d_cos(double x) { return -sin(x); }
+static double d_log(double x) { return 1 / x; }
+static double d_log10(double x) { return 1 / (x * M_LN10); }
+static double d_log2(double x) { return 1 / (x * M_LN2); }
+static double d_sinh(double x) { return cosh(x); }
+static double d_sqrt(double x) { return 0.5 / sqrt(x); }
+static double d_tan(double x) { return 1 + tan(x) * tan(x); }
+static double d_tanh(double x) { return 1 - tanh(x) * tanh(x); }
+
+// The rounding functions are flat between their steps
+static double d_step(__attribute__((unused)) double x) { return 0; }
+
+static void d_atan2(double y, double x, double* partials) {
+  double norm = x * x + y * y;
+  partials[0] = x / norm;
+  partials[1] = -y / norm;
+}
+
+static void d_hypot(double x, double y, double* partials) {
+  double norm = hypot(x, y);
+  partials[0] = x / norm;
+  partials[1] = y / norm;
+}
+
+// The operand that kernel_max and kernel_min pick gets the whole derivative
+static void d_max(double a, double b, double* partials) {
+  bool first = a > b || isnan(b);
+  partials[0] = first;
+  partials[1] = !first;
+}
+
+static void d_min(double a, double b, double* partials) {
+  bool first = a < b || isnan(b);
+  partials[0] = first;
+  partials[1] = !first;
+}
+
+// Along the exponent, a base that isn't positive only has a derivative
+// where the exponent is constant, so that one is taken as 0
+static void d_pow(double x, double y, double* partials) {
+  partials[0] = y * pow(x, y - 1);
+  partials[1] = x > 0 ? pow(x, y) * log(x) : 0;
+}
+
+// Sorted by name for the binary search
+static const func_t builtins[] = {
+  FUNC_UNARY("abs", fabs, KERNEL_ABS, d_abs),
+  FUNC_UNARY("acos", acos, KERNEL_NONE, d_acos),
+  FUNC_UNARY("asin", asin, KERNEL_NONE, d_asin),
+  FUNC_UNARY("atan", atan, KERNEL_NONE, d_atan),
+  FUNC_BINARY("atan2", atan2, KERNEL_NONE, d_atan2),
+  FUNC_UNARY("cbrt", cbrt, KERNEL_NONE, d_cbrt),
+  FUNC_UNARY("ceil", ceil, KERNEL_CEIL, d_step),
+  FUNC_UNARY("cos", cos, KERNEL_NONE, d_cos),
+  FUNC_UNARY("cosh", cosh, KERNEL_NONE, d_cosh),
+  FUNC_UNARY("exp", exp, KERNEL_NONE, exp),
+  FUNC_UNARY("floor", floor, KERNEL_FLOOR, d_step),
+  FUNC_BINARY("hypot", hypot, KERNEL_NONE, d_hypot),
+  FUNC_UNARY("log", log, KERNEL_NONE, d_log),
+  FUNC_UNARY("log10", log10, KERNEL_NONE, d_log10),
+  FUNC_UNARY("log2", log2, KERNEL_NONE, d_log2),
+  FUNC_BINARY("max", kernel_max, KERNEL_MAX, d_max),
+  FUNC_BINARY("min", kernel_min, KERNEL_MIN, d_min),
+  FUNC_BINARY("pow", pow, KERNEL_NONE, d_pow),
+  FUNC_UNARY("round", round, KERNEL_NONE, d_step),
+  FUNC_UNARY("sin", sin, KERNEL_NONE, cos),
+  FUNC_UNARY("sinh", sinh, KERNEL_NONE, d_sinh),
+  FUNC_UNARY("sqrt", sqrt, KERNEL_SQRT, d_sqrt),
+  FUNC_UNARY("tan", tan, KERNEL_NONE, d_tan),
+  FUNC_UNARY("tanh", tanh, KERNEL_NONE, d_tanh),
+  FUNC_UNARY("trunc", trunc, KERNEL_NONE, d_step)
+};
+
+static int compare(const char* name, size_t size, const func_t* func) {
+  int order = strncmp(name, func->name, size);
+  return order != 0 ? order : -(func->name[size] != '\0');
+}
+
+extern const func_t* func_find(const char* name, size_t size) {
+  size_t low = 0;
+  size_t high = sizeof(builtins) / sizeof(builtins[0]);
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    int order = compare(name, size, &builtins[middle]);
+    if (order == 0)
+      return &builtins[middle];
+    if (order < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  return NULL;
+}
+
+// The function and its name are never freed on their own, so both come
+// from the arena of the calc
+extern func_t* func_new(arena_t* arena, const char* name, size_t arity, artm_fn_t fn, artm_vec_fn_t vec, unsigned flags) {
+  size_t size = strlen(name);
+  func_t* func = (func_t*) arena_alloc(arena, sizeof(func_t) + size + 1);
+  if (func == NULL)
+    return NULL;
+
+  func->name = memcpy(func + 1, name, size + 1);
+
+  func->arity = arity;
+  func->flags = flags;
+  func->kind = FUNC_ARRAY;
+  func->kernel = KERNEL_NONE;
+  func->as.array = fn;
+  func->vector = vec;
+  func->derivative.unary = NULL;
+  return func;
+}
@@ -0,0 +1,81 @@
+/* Func - Built-in math functions
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_FUNC_H
+#define ARITHMO_FUNC_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "arithmo.h"
+#include "alloc.h"
+#include "kernels.h"
+
+// No function takes more arguments, so they always fit on the C stack
+#define FUNC_MAX_ARITY ARTM_FN_MAX_ARITY
+
+// The result only depends on the arguments, so calls can be folded
+#define FUNC_PURE ARTM_FN_PURE
+
+typedef struct func func_t;
+typedef double (*func_unary_t)(double);
+typedef double (*func_binary_t)(double, double);
+typedef void (*func_partials_t)(double, double, double*);
+
+// The arguments of the built-in functions are passed in registers, and the
+// registered ones get them straight from the evaluation stack
+typedef enum {
+  FUNC_UNARY,
+  FUNC_BINARY,
+  FUNC_ARRAY
+} func_kind_t;
+
+struct func {
+  const char* name;
+  size_t arity;
+  unsigned flags;
+  func_kind_t kind;
+  kernel_func_t kernel;
+  union {
+    func_unary_t unary;
+    func_binary_t binary;
+    artm_fn_t array;
+  } as;
+  artm_vec_fn_t vector;
+  // f' of a unary built-in, or the two partial derivatives of a binary one
+  // (the registered functions have none)
+  union {
+    func_unary_t unary;
+    func_partials_t binary;
+  } derivative;
+};
+
+extern const func_t* func_find(const char* name, size_t size);
+
+extern func_t* func_new(arena_t* arena, const char* name, size_t arity, artm_fn_t fn, artm_vec_fn_t vec, unsigned flags);
+
+static inline double func_call(const func_t* func, const double* args) {
+  switch (func->kind) {
+    case FUNC_UNARY: return func->as.unary(args[0]);
+    case FUNC_BINARY: return func->as.binary(args[0], args[1]);
+    default: return func->as.array(args);
+  }
+}
+
+#endif // ARITHMO_FUNC_H
@@ -0,0 +1,284 @@
+/* Graph - Live formulas and their dependency graph
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "calc.h"
+#include "compiler.h"
+#include "graph.h"
+#include "optimizer.h"
+#include "result.h"
+
+#define GRAPH_MIN_DEPENDENTS 4
+
+static bool own_inputs(artm_calc_t* calc, program_t* program);
+static bool collect_inputs(formula_t* formula);
+static bool link_input(artm_var_t input, artm_var_t var);
+static void unlink_input(artm_var_t input, artm_var_t var);
+static void mark_dependents(artm_var_t var, size_t mark);
+static void free_formula(formula_t* formula);
+
+// Points a token of the formula's own copy back into the caller's text
+static inline artm_result_t rebase(artm_result_t result, const formula_t* formula, const char* source) {
+  if (result.status != ARTM_SUCCESS && result.as.token.target != NULL)
+    result.as.token.target = source + (result.as.token.target - formula->source);
+  return result;
+}
+
+static inline void enqueue(artm_var_t var) {
+  if (!var->queued) {
+    var->queued = true;
+    var->next_dirty = var->calc->dirty;
+    var->calc->dirty = var;
+  }
+}
+
+extern artm_result_t graph_define(artm_var_t var, const char* source, size_t size) {
+  const artm_allocator_t* allocator = &var->calc->allocator;
+  formula_t* formula = (formula_t*) alloc_zeroed(allocator, 1, sizeof(formula_t));
+  if (formula == NULL || (formula->source = alloc_strndup(allocator, source, size)) == NULL) {
+    alloc_free(allocator, formula);
+    return ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+  }
+
+  program_init(&formula->program, allocator);
+  artm_result_t result = compile(var->calc, &formula->program, formula->source, size, false);
+  if (result.status == ARTM_SUCCESS && formula->program.code[formula->program.size - 1].op == OP_STORE)
+    result = ARTM_ERROR(ARTM_INV_TOKEN, formula->program.tokens[formula->program.size - 1]);
+  if (result.status == ARTM_SUCCESS && !own_inputs(var->calc, &formula->program))
+    result = ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+  if (result.status == ARTM_SUCCESS && !optimize(&formula->program, ARTM_OPT_DEFAULT))
+    result = ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+  if (result.status == ARTM_SUCCESS && !collect_inputs(formula))
+    result = ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+
+  // A cycle exists if the variable already (transitively) feeds one of the inputs
+  if (result.status == ARTM_SUCCESS) {
+    size_t mark = ++var->calc->mark;
+    mark_dependents(var, mark);
+    for (size_t i = 0; i < formula->program.size; ++i) {
+      const instr_t* instr = &formula->program.code[i];
+      if (instr->op == OP_LOAD && (instr->as.var == var || instr->as.var->mark == mark)) {
+        result = ARTM_ERROR(ARTM_CYCLE, formula->program.tokens[i]);
+        break;
+      }
+    }
+  }
+
+  if (result.status == ARTM_SUCCESS)
+    result = program_run(&formula->program);
+
+  if (result.status != ARTM_SUCCESS) {
+    result = rebase(result, formula, source);
+    free_formula(formula);
+    return result;
+  }
+
+  graph_clear(var);
+  for (size_t i = 0; i < formula->count; ++i) {
+    if (!link_input(formula->inputs[i], var)) {
+      for (size_t j = 0; j < i; ++j)
+        unlink_input(formula->inputs[j], var);
+      free_formula(formula);
+      return ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+    }
+  }
+
+  var->formula = formula;
+  var_store(var, result.as.value);
+  var->dirty = false;
+  graph_touch(var);
+  return result;
+}
+
+extern void graph_clear(artm_var_t var) {
+  formula_t* formula = var->formula;
+  if (formula == NULL)
+    return;
+
+  for (size_t i = 0; i < formula->count; ++i)
+    unlink_input(formula->inputs[i], var);
+  free_formula(formula);
+  var->formula = NULL;
+  var->dirty = false;
+}
+
+// Only used when the whole calc goes away, so the other slots are left alone
+extern void graph_free(artm_var_t var) {
+  if (var->formula != NULL)
+    free_formula(var->formula);
+  alloc_free(&var->calc->allocator, var->dependents.items);
+}
+
+// Dirty formulas only ever have dirty dependents, so the walk stops at
+// the first formula that is already dirty. The pending formulas are linked
+// through next_work, so a long chain doesn't use the C stack
+extern void graph_touch(artm_var_t var) {
+  artm_var_t work = NULL;
+  for (;;) {
+    for (size_t i = 0; i < var->dependents.count; ++i) {
+      artm_var_t dependent = var->dependents.items[i];
+      if (!dependent->dirty) {
+        dependent->dirty = true;
+        enqueue(dependent);
+        dependent->next_work = work;
+        work = dependent;
+      }
+    }
+
+    if (work == NULL)
+      return;
+    var = work;
+    work = work->next_work;
+  }
+}
+
+// A depth-first walk over the dirty inputs, with the path linked through
+// next_work: a formula is recomputed once all its inputs are up to date, so
+// the loads of its program never have to recompute anything
+extern void graph_update(artm_var_t var) {
+  if (!var->dirty || var->formula == NULL)
+    return;
+
+  var->cursor = 0;
+  var->next_work = NULL;
+  while (var != NULL) {
+    const formula_t* formula = var->formula;
+    artm_var_t input = NULL;
+    while (input == NULL && var->cursor < formula->count) {
+      artm_var_t candidate = formula->inputs[var->cursor++];
+      if (candidate->dirty && candidate->formula != NULL)
+        input = candidate;
+    }
+
+    if (input != NULL) {
+      input->cursor = 0;
+      input->next_work = var;
+      var = input;
+      continue;
+    }
+
+    artm_result_t result = program_run(&formula->program);
+    if (result.status == ARTM_SUCCESS)
+      var_store(var, result.as.value);
+    var->dirty = false;
+    var = var->next_work;
+  }
+}
+
+extern void graph_refresh(artm_calc_t* calc) {
+  artm_var_t var = calc->dirty;
+  calc->dirty = NULL;
+  while (var != NULL) {
+    artm_var_t next = var->next_dirty;
+    var->queued = false;
+    var->next_dirty = NULL;
+    graph_update(var);
+    var = next;
+  }
+}
+
+// The formulas of a fork read its own copies of the parent's variables, so
+// overriding one of them later is seen and the parent is never linked to
+static bool own_inputs(artm_calc_t* calc, program_t* program) {
+  for (size_t i = 0; i < program->size; ++i) {
+    instr_t* instr = &program->code[i];
+    if (instr->op == OP_LOAD && instr->as.var->calc != calc) {
+      instr->as.var = calc_resolve(calc, instr->as.var->name, strlen(instr->as.var->name));
+      if (instr->as.var == NULL)
+        return false;
+    }
+  }
+  return true;
+}
+
+static bool collect_inputs(formula_t* formula) {
+  const program_t* program = &formula->program;
+  formula->inputs = (artm_var_t*) alloc_new(program->allocator, program->size * sizeof(artm_var_t));
+  if (formula->inputs == NULL)
+    return false;
+
+  for (size_t i = 0; i < program->size; ++i) {
+    if (program->code[i].op != OP_LOAD)
+      continue;
+
+    artm_var_t input = program->code[i].as.var;
+    size_t j = 0;
+    while (j < formula->count && formula->inputs[j] != input)
+      ++j;
+    if (j == formula->count)
+      formula->inputs[formula->count++] = input;
+  }
+  return true;
+}
+
+static bool link_input(artm_var_t input, artm_var_t var) {
+  if (input->dependents.count == input->dependents.capacity) {
+    size_t capacity = input->dependents.capacity < GRAPH_MIN_DEPENDENTS
+      ? GRAPH_MIN_DEPENDENTS
+      : input->dependents.capacity * 2;
+
+    artm_var_t* items = (artm_var_t*) alloc_resize(&input->calc->allocator, input->dependents.items, capacity * sizeof(artm_var_t));
+    if (items == NULL)
+      return false;
+
+    input->dependents.items = items;
+    input->dependents.capacity = capacity;
+  }
+
+  input->dependents.items[input->dependents.count++] = var;
+  return true;
+}
+
+static void unlink_input(artm_var_t input, artm_var_t var) {
+  for (size_t i = 0; i < input->dependents.count; ++i) {
+    if (input->dependents.items[i] == var) {
+      input->dependents.items[i] = input->dependents.items[--input->dependents.count];
+      return;
+    }
+  }
+}
+
+static void mark_dependents(artm_var_t var, size_t mark) {
+  artm_var_t work = NULL;
+  for (;;) {
+    for (size_t i = 0; i < var->dependents.count; ++i) {
+      artm_var_t dependent = var->dependents.items[i];
+      if (dependent->mark != mark) {
+        dependent->mark = mark;
+        dependent->next_work = work;
+        work = dependent;
+      }
+    }
+
+    if (work == NULL)
+      return;
+    var = work;
+    work = work->next_work;
+  }
+}
+
+static void free_formula(formula_t* formula) {
+  const artm_allocator_t* allocator = formula->program.allocator;
+  program_free(&formula->program);
+  alloc_free(allocator, formula->inputs);
+  alloc_free(allocator, formula->source);
+  alloc_free(allocator, formula);
+}
@@ -0,0 +1,45 @@
+/* Graph - Live formulas and their dependency graph
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_GRAPH_H
+#define ARITHMO_GRAPH_H
+
+#include <stddef.h>
+
+#include "arithmo.h"
+#include "program.h"
+
+typedef struct formula formula_t;
+
+struct formula {
+  char* source;
+  program_t program;
+  artm_var_t* inputs;
+  size_t count;
+};
+
+extern artm_result_t graph_define(artm_var_t var, const char* source, size_t size);
+extern void graph_clear(artm_var_t var);
+extern void graph_free(artm_var_t var);
+
+extern void graph_touch(artm_var_t var);
+extern void graph_update(artm_var_t var);
+extern void graph_refresh(artm_calc_t* calc);
+
+#endif // ARITHMO_GRAPH_H
@@ -0,0 +1,751 @@
+/* Image - Binary images of compiled expressions and variables
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "arithmo.h"
+#include "alloc.h"
+#include "calc.h"
+#include "func.h"
+#include "graph.h"
+#include "jit.h"
+#include "parser.h"
+#include "program.h"
+#include "table.h"
+
+// Bump the version whenever the layout below (or the opcodes and token
+// types) change
+#define IMAGE_VERSION 2
+#define IMAGE_ORDER 0x01020304u
+#define IMAGE_NO_TOKEN UINT32_MAX
+#define IMAGE_JIT 1u
+#define IMAGE_DEFINED 1u
+#define IMAGE_CONSTANT 2u
+#define IMAGE_FORMULA 4u
+
+typedef struct image_header image_header_t;
+typedef struct image_expr image_expr_t;
+typedef struct image_name image_name_t;
+typedef struct image_instr image_instr_t;
+typedef struct image_var image_var_t;
+typedef struct image image_t;
+typedef struct snapshot snapshot_t;
+
+// The header is followed by the expressions, the variable names, the
+// function names, the code and the strings, in this order. Everything is
+// an offset or an index, so the file can be used wherever it is mapped
+struct image_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t order;
+  uint64_t checksum;
+  uint64_t size;
+  uint64_t exprs;
+  uint64_t vars;
+  uint64_t funcs;
+  uint64_t code;
+  uint64_t strings;
+};
+
+struct image_expr {
+  uint64_t source;
+  uint64_t code;
+  uint32_t size;
+  uint32_t count;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+struct image_name {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t arity;
+};
+
+// The operand is the bits of a constant or the index of a name; the
+// token is relative to the source of its expression
+struct image_instr {
+  uint64_t operand;
+  uint32_t offset;
+  uint32_t size;
+  uint16_t op;
+  uint16_t type;
+  uint32_t reserved;
+};
+
+// A snapshot only has variables (and strings): the value, the name and,
+// for a formula, its source text
+struct image_var {
+  uint64_t value;
+  uint64_t name;
+  uint64_t source;
+  uint32_t name_size;
+  uint32_t source_size;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+// The sections of a mapped (or a being written) image
+struct image {
+  image_expr_t* exprs;
+  image_name_t* vars;
+  image_name_t* funcs;
+  image_instr_t* code;
+  char* strings;
+};
+
+// Walks the variables of a calc twice: once to measure and once to write
+struct snapshot {
+  char* body;
+  size_t vars;
+  size_t strings;
+  bool fits;
+};
+
+static const char magic[8] = { 'A', 'R', 'T', 'M', 'I', 'M', 'G', '\0' };
+static const char snapshot_magic[8] = { 'A', 'R', 'T', 'M', 'S', 'N', 'P', '\0' };
+
+static artm_status_t collect(const artm_expr_t* const* exprs, size_t count, table_t* names, image_header_t* header);
+static void write_body(const artm_expr_t* const* exprs, size_t count, table_t* names, const image_header_t* header, char* body);
+static artm_status_t read_body(artm_calc_t* calc, const image_header_t* header, const char* body, artm_expr_t** exprs);
+static artm_status_t check_code(const image_t* image, const image_header_t* header, const image_expr_t* expr, size_t max_height);
+static artm_expr_t* load_expr(artm_calc_t* calc, const image_t* image, const image_expr_t* expr, const artm_var_t* vars, const func_t** funcs);
+static void measure_var(artm_var_t var, void* payload);
+static void write_var(artm_var_t var, void* payload);
+static artm_status_t check_vars(const artm_calc_t* calc, const image_header_t* header, const char* body);
+static artm_status_t restore_vars(artm_calc_t* calc, const image_header_t* header, const char* body);
+
+static artm_status_t write_image(const char* path, image_header_t* header, const char* body);
+static artm_status_t map_image(const char* path, const char* kind, image_header_t* header, char** data, size_t* size);
+static uint64_t checksum(const char* data, size_t size);
+
+static inline size_t padded(size_t size) {
+  return (size + 7) & ~(size_t) 7;
+}
+
+static inline bool has_operand(opcode_t op) {
+  return op == OP_LOAD || op == OP_STORE || op == OP_CALL;
+}
+
+static inline void split(const image_header_t* header, const char* body, image_t* image) {
+  image->exprs = (image_expr_t*) body;
+  image->vars = (image_name_t*) (image->exprs + header->exprs);
+  image->funcs = image->vars + header->vars;
+  image->code = (image_instr_t*) (image->funcs + header->funcs);
+  image->strings = (char*) (image->code + header->code);
+}
+
+// Returns the index of a variable or function in its section, or assigns the next one
+static inline bool index_of(table_t* names, const void* name, size_t* next, size_t* index) {
+  table_value_t found = table_get(names, (const char*) &name, sizeof(name));
+  if (found.type == TAB_VAL_DBL) {
+    *index = (size_t) found.as.dbl;
+    return true;
+  }
+
+  *index = (*next)++;
+  return table_put(names, (const char*) &name, sizeof(name), TABLE_DBL_VALUE((double) *index));
+}
+
+extern artm_status_t artm_expr_save(const artm_expr_t* const* exprs, size_t count, const char* path) {
+  if (exprs == NULL || path == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    if (exprs[i] == NULL) {
+      return ARTM_NULL_EXPR;
+    }
+  }
+
+  // The expressions may come from different calcs, so the scratch memory
+  // comes from malloc
+  table_t names;
+  table_init(&names, 0, &alloc_default);
+  image_header_t header = { .version = IMAGE_VERSION, .order = IMAGE_ORDER, .exprs = count };
+  memcpy(header.magic, magic, sizeof(magic));
+  artm_status_t status = collect(exprs, count, &names, &header);
+  if (status != ARTM_SUCCESS) {
+    table_free(&names);
+    return status;
+  }
+
+  char* body = (char*) alloc_zeroed(&alloc_default, header.size > 0 ? header.size : 1, 1);
+  if (body == NULL) {
+    table_free(&names);
+    return ARTM_ALLOC_ERR;
+  }
+
+  write_body(exprs, count, &names, &header, body);
+  table_free(&names);
+  status = write_image(path, &header, body);
+  alloc_free(&alloc_default, body);
+  return status;
+}
+
+// Everything is checked before the first expression is created, so a
+// damaged or outdated file leaves nothing behind but ARTM_BAD_FORMAT
+extern artm_status_t artm_expr_load(artm_calc_t* calc, const char* path, artm_expr_t** exprs, size_t count) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  if (path == NULL || exprs == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  char* data;
+  size_t size;
+  image_header_t header;
+  artm_status_t status = map_image(path, magic, &header, &data, &size);
+  if (status != ARTM_SUCCESS) {
+    return status;
+  }
+
+  status = header.exprs == count ? read_body(calc, &header, data + sizeof(header), exprs) : ARTM_BAD_FORMAT;
+  munmap(data, size);
+  return status;
+}
+
+extern artm_status_t artm_calc_snapshot(artm_calc_t* calc, const char* path) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  if (path == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  snapshot_t snapshot = { .fits = true };
+  store_each(&calc->decls, measure_var, &snapshot);
+  if (!snapshot.fits) {
+    return ARTM_BAD_FORMAT;
+  }
+
+  image_header_t header = {
+    .version = IMAGE_VERSION,
+    .order = IMAGE_ORDER,
+    .vars = snapshot.vars,
+    .strings = padded(snapshot.strings)
+  };
+  memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+  header.size = header.vars * sizeof(image_var_t) + header.strings;
+  char* body = (char*) alloc_zeroed(&calc->allocator, header.size > 0 ? header.size : 1, 1);
+  if (body == NULL) {
+    return ARTM_ALLOC_ERR;
+  }
+
+  // The strings follow the records; the table order is the same both times
+  snapshot = (snapshot_t) { .body = body, .strings = header.vars * sizeof(image_var_t) };
+  store_each(&calc->decls, write_var, &snapshot);
+  artm_status_t status = write_image(path, &header, body);
+  alloc_free(&calc->allocator, body);
+  return status;
+}
+
+// Like artm_expr_load, the whole file is checked before the calc is touched
+extern artm_status_t artm_calc_restore(artm_calc_t* calc, const char* path) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+
+  if (path == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  char* data;
+  size_t size;
+  image_header_t header;
+  artm_status_t status = map_image(path, snapshot_magic, &header, &data, &size);
+  if (status != ARTM_SUCCESS) {
+    return status;
+  }
+
+  const char* body = data + sizeof(header);
+  status = check_vars(calc, &header, body);
+  if (status == ARTM_SUCCESS)
+    status = restore_vars(calc, &header, body);
+  munmap(data, size);
+  return status;
+}
+
+// Numbers the variables and functions, and measures the sections; a
+// single source, name or program has to fit in 32 bits
+static artm_status_t collect(const artm_expr_t* const* exprs, size_t count, table_t* names, image_header_t* header) {
+  size_t vars = 0, funcs = 0, strings = 0, code = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const program_t* program = &exprs[i]->program;
+    size_t size = strlen(exprs[i]->source);
+    if (size >= IMAGE_NO_TOKEN || program->size >= IMAGE_NO_TOKEN)
+      return ARTM_BAD_FORMAT;
+
+    strings += size;
+    code += program->size;
+    for (size_t j = 0; j < program->size; ++j) {
+      const instr_t* instr = &program->code[j];
+      if (!has_operand(instr->op))
+        continue;
+
+      size_t index;
+      bool call = instr->op == OP_CALL;
+      size_t before = call ? funcs : vars;
+      const void* key = call ? (const void*) instr->as.func : (const void*) instr->as.var;
+      if (!index_of(names, key, call ? &funcs : &vars, &index))
+        return ARTM_ALLOC_ERR;
+      if ((call ? funcs : vars) != before) {
+        size_t name = strlen(call ? instr->as.func->name : instr->as.var->name);
+        if (name >= IMAGE_NO_TOKEN)
+          return ARTM_BAD_FORMAT;
+        strings += name;
+      }
+    }
+  }
+
+  header->vars = vars;
+  header->funcs = funcs;
+  header->code = code;
+  header->strings = padded(strings);
+  header->size = count * sizeof(image_expr_t)
+    + (vars + funcs) * sizeof(image_name_t)
+    + code * sizeof(image_instr_t)
+    + header->strings;
+  return ARTM_SUCCESS;
+}
+
+static void write_body(const artm_expr_t* const* exprs, size_t count, table_t* names, const image_header_t* header, char* body) {
+  image_t image;
+  split(header, body, &image);
+
+  size_t strings = 0, code = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const artm_expr_t* expr = exprs[i];
+    const program_t* program = &expr->program;
+    size_t size = strlen(expr->source);
+    image.exprs[i] = (image_expr_t) {
+      .source = strings,
+      .code = code,
+      .size = (uint32_t) size,
+      .count = (uint32_t) program->size,
+      .flags = expr->jit.code != NULL ? IMAGE_JIT : 0
+    };
+    memcpy(image.strings + strings, expr->source, size);
+    strings += size;
+
+    for (size_t j = 0; j < program->size; ++j, ++code) {
+      const instr_t* instr = &program->code[j];
+      const token_t* token = &program->tokens[j];
+      image_instr_t* out = &image.code[code];
+      *out = (image_instr_t) {
+        .offset = token->target != NULL ? (uint32_t) (token->target - expr->source) : IMAGE_NO_TOKEN,
+        .size = (uint32_t) token->size,
+        .op = (uint16_t) instr->op,
+        .type = (uint16_t) token->type
+      };
+
+      if (instr->op == OP_CONST) {
+        memcpy(&out->operand, &instr->as.value, sizeof(double));
+        continue;
+      }
+
+      if (!has_operand(instr->op))
+        continue;
+
+      // The first time a name is met its string goes after the sources
+      bool call = instr->op == OP_CALL;
+      const void* key = call ? (const void*) instr->as.func : (const void*) instr->as.var;
+      out->operand = (uint64_t) table_get(names, (const char*) &key, sizeof(key)).as.dbl;
+      image_name_t* name = call ? &image.funcs[out->operand] : &image.vars[out->operand];
+      if (name->size == 0) {
+        const char* text = call ? instr->as.func->name : instr->as.var->name;
+        *name = (image_name_t) {
+          .offset = strings,
+          .size = (uint32_t) strlen(text),
+          .arity = call ? (uint32_t) instr->as.func->arity : 0
+        };
+        memcpy(image.strings + strings, text, name->size);
+        strings += name->size;
+      }
+    }
+  }
+}
+
+static artm_status_t read_body(artm_calc_t* calc, const image_header_t* header, const char* body, artm_expr_t** exprs) {
+  // The section counts must add up before any of them is used
+  uint64_t records = header->size / sizeof(image_name_t);
+  if (header->exprs > records || header->vars > records || header->funcs > records || header->code > records
+    || header->strings > header->size
+    || header->exprs * sizeof(image_expr_t) + (header->vars + header->funcs) * sizeof(image_name_t)
+      + header->code * sizeof(image_instr_t) + header->strings != header->size
+  ) {
+    return ARTM_BAD_FORMAT;
+  }
+
+  image_t image;
+  split(header, body, &image);
+
+  for (size_t i = 0; i < header->vars + header->funcs; ++i) {
+    const image_name_t* name = &image.vars[i];
+    if (name->offset > header->strings || name->size > header->strings - name->offset || name->size == 0
+      || memchr(image.strings + name->offset, '\0', name->size) != NULL
+    ) {
+      return ARTM_BAD_FORMAT;
+    }
+  }
+
+  for (size_t i = 0; i < header->exprs; ++i) {
+    artm_status_t status = check_code(&image, header, &image.exprs[i], parser_max_height(calc->max_depth));
+    if (status != ARTM_SUCCESS)
+      return status;
+  }
+
+  // The functions must be known to the calc with the same arity
+  const artm_allocator_t* allocator = &calc->allocator;
+  artm_var_t* vars = (artm_var_t*) alloc_new(allocator, (header->vars + 1) * sizeof(artm_var_t));
+  const func_t** funcs = (const func_t**) alloc_new(allocator, (header->funcs + 1) * sizeof(const func_t*));
+  artm_status_t status = vars != NULL && funcs != NULL ? ARTM_SUCCESS : ARTM_ALLOC_ERR;
+  for (size_t i = 0; status == ARTM_SUCCESS && i < header->funcs; ++i) {
+    const image_name_t* name = &image.funcs[i];
+    funcs[i] = calc_func(calc, image.strings + name->offset, name->size);
+    if (funcs[i] == NULL || funcs[i]->arity != name->arity)
+      status = ARTM_UNDEF_FN;
+  }
+
+  for (size_t i = 0; status == ARTM_SUCCESS && i < header->vars; ++i) {
+    const image_name_t* name = &image.vars[i];
+    vars[i] = calc_resolve(calc, image.strings + name->offset, name->size);
+    if (vars[i] == NULL)
+      status = ARTM_ALLOC_ERR;
+  }
+
+  size_t loaded = 0;
+  for (; status == ARTM_SUCCESS && loaded < header->exprs; ++loaded) {
+    exprs[loaded] = load_expr(calc, &image, &image.exprs[loaded], vars, funcs);
+    if (exprs[loaded] == NULL)
+      status = ARTM_ALLOC_ERR;
+  }
+
+  if (status != ARTM_SUCCESS) {
+    for (size_t i = 0; i < loaded; ++i) {
+      artm_expr_free(exprs[i]);
+      exprs[i] = NULL;
+    }
+  }
+
+  alloc_free(allocator, vars);
+  alloc_free(allocator, funcs);
+  return status;
+}
+
+// The code has to be what the compiler could have produced: known
+// opcodes, names and tokens in range, a stack that never underflows nor
+// grows past what the parser of this calc allows, and one value at the end
+// (an empty expression is compiled to a constant too)
+static artm_status_t check_code(const image_t* image, const image_header_t* header, const image_expr_t* expr, size_t max_height) {
+  if (expr->source > header->strings || expr->size > header->strings - expr->source
+    || expr->code > header->code || expr->count > header->code - expr->code
+  ) {
+    return ARTM_BAD_FORMAT;
+  }
+
+  if (memchr(image->strings + expr->source, '\0', expr->size) != NULL) {
+    return ARTM_BAD_FORMAT;
+  }
+
+  size_t height = 0;
+  for (size_t i = 0; i < expr->count; ++i) {
+    const image_instr_t* instr = &image->code[expr->code + i];
+    if (instr->op > OP_CALL || instr->type > TKN_END
+      || (instr->offset != IMAGE_NO_TOKEN && (instr->offset > expr->size || instr->size > expr->size - instr->offset))
+    ) {
+      return ARTM_BAD_FORMAT;
+    }
+
+    size_t pops = 0, pushes = 1;
+    switch ((opcode_t) instr->op) {
+      case OP_CONST:
+        break;
+      case OP_LOAD:
+        if (instr->operand >= header->vars)
+          return ARTM_BAD_FORMAT;
+        break;
+      case OP_STORE:
+        if (instr->operand >= header->vars)
+          return ARTM_BAD_FORMAT;
+        pops = 1;
+        break;
+      case OP_NEG:
+        pops = 1;
+        break;
+      case OP_CALL:
+        if (instr->operand >= header->funcs || image->funcs[instr->operand].arity > FUNC_MAX_ARITY)
+          return ARTM_BAD_FORMAT;
+        pops = (size_t) image->funcs[instr->operand].arity;
+        break;
+      default:
+        pops = 2;
+        break;
+    }
+
+    if (height < pops)
+      return ARTM_BAD_FORMAT;
+    height += pushes - pops;
+    if (height > max_height)
+      return ARTM_BAD_FORMAT;
+  }
+  return height == 1 ? ARTM_SUCCESS : ARTM_BAD_FORMAT;
+}
+
+// One allocation per expression, since most of the loading time goes to
+// the allocator and to the page faults of fresh memory
+static artm_expr_t* load_expr(artm_calc_t* calc, const image_t* image, const image_expr_t* expr, const artm_var_t* vars, const func_t** funcs) {
+  size_t capacity = expr->count > 0 ? expr->count : 1;
+  size_t size = sizeof(artm_expr_t) + capacity * (sizeof(instr_t) + sizeof(token_t)) + expr->size + 1;
+  artm_expr_t* result = (artm_expr_t*) alloc_new(&calc->allocator, size);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  result->calc = calc;
+  result->packed = true;
+  program_init(&result->program, &calc->allocator);
+  jit_init(&result->jit);
+
+  program_t* program = &result->program;
+  program->code = (instr_t*) (result + 1);
+  program->tokens = (token_t*) (program->code + capacity);
+  result->source = (char*) (program->tokens + capacity);
+  memcpy(result->source, image->strings + expr->source, expr->size);
+  result->source[expr->size] = '\0';
+
+  program->capacity = capacity;
+  program->size = expr->count;
+  for (size_t i = 0; i < expr->count; ++i) {
+    const image_instr_t* in = &image->code[expr->code + i];
+    instr_t* instr = &program->code[i];
+    instr->op = (opcode_t) in->op;
+    switch (instr->op) {
+      case OP_CONST: memcpy(&instr->as.value, &in->operand, sizeof(double)); break;
+      case OP_LOAD:
+      case OP_STORE: instr->as.var = vars[in->operand]; break;
+      case OP_CALL: instr->as.func = funcs[in->operand]; break;
+      default: break;
+    }
+
+    program->tokens[i] = (token_t) {
+      .type = (token_type_t) in->type,
+      .target = in->offset != IMAGE_NO_TOKEN ? result->source + in->offset : NULL,
+      .size = in->offset != IMAGE_NO_TOKEN ? in->size : 0
+    };
+  }
+
+  program_measure(program);
+  if (expr->flags & IMAGE_JIT)
+    jit_compile(&result->jit, program);
+  return result;
+}
+
+// A name or formula has to fit in 32 bits, like a source in an image
+static void measure_var(artm_var_t var, void* payload) {
+  snapshot_t* snapshot = (snapshot_t*) payload;
+  size_t size = strlen(var->name);
+  size_t source = var->formula != NULL ? strlen(var->formula->source) : 0;
+  snapshot->fits = snapshot->fits && size < IMAGE_NO_TOKEN && source < IMAGE_NO_TOKEN;
+  snapshot->strings += size + source;
+  ++snapshot->vars;
+}
+
+static void write_var(artm_var_t var, void* payload) {
+  snapshot_t* snapshot = (snapshot_t*) payload;
+  image_var_t* out = (image_var_t*) snapshot->body + snapshot->vars++;
+
+  *out = (image_var_t) {
+    .name = snapshot->strings,
+    .name_size = (uint32_t) strlen(var->name),
+    .flags = (var_defined(var) ? IMAGE_DEFINED : 0) | (var->constant ? IMAGE_CONSTANT : 0)
+  };
+  double value = var_value(var);
+  memcpy(&out->value, &value, sizeof(double));
+  memcpy(snapshot->body + snapshot->strings, var->name, out->name_size);
+  snapshot->strings += out->name_size;
+
+  if (var->formula != NULL) {
+    out->flags |= IMAGE_FORMULA;
+    out->source = snapshot->strings;
+    out->source_size = (uint32_t) strlen(var->formula->source);
+    memcpy(snapshot->body + snapshot->strings, var->formula->source, out->source_size);
+    snapshot->strings += out->source_size;
+  }
+}
+
+// Offsets are relative to the body here, since the strings follow the records
+static artm_status_t check_vars(const artm_calc_t* calc, const image_header_t* header, const char* body) {
+  if (header->exprs != 0 || header->funcs != 0 || header->code != 0
+    || header->vars > header->size / sizeof(image_var_t)
+    || header->strings != header->size - header->vars * sizeof(image_var_t)
+  ) {
+    return ARTM_BAD_FORMAT;
+  }
+
+  const image_var_t* vars = (const image_var_t*) body;
+  for (size_t i = 0; i < header->vars; ++i) {
+    const image_var_t* var = &vars[i];
+    if (var->name < header->size - header->strings || var->name > header->size
+      || var->name_size > header->size - var->name || var->name_size == 0
+      || memchr(body + var->name, '\0', var->name_size) != NULL
+      || var->flags > (IMAGE_DEFINED | IMAGE_CONSTANT | IMAGE_FORMULA)
+    ) {
+      return ARTM_BAD_FORMAT;
+    }
+
+    if (var->flags & IMAGE_FORMULA) {
+      if ((var->flags & IMAGE_CONSTANT) || !(var->flags & IMAGE_DEFINED) || var->source_size == 0
+        || var->source < header->size - header->strings || var->source > header->size
+        || var->source_size > header->size - var->source
+        || memchr(body + var->source, '\0', var->source_size) != NULL
+      ) {
+        return ARTM_BAD_FORMAT;
+      }
+    }
+  }
+
+  // The constants of the calc stay what they are
+  for (size_t i = 0; i < header->vars; ++i) {
+    const image_var_t* var = &vars[i];
+    artm_var_t found = calc_find(calc, body + var->name, var->name_size);
+    if (found == NULL || !found->constant || !(var->flags & IMAGE_DEFINED))
+      continue;
+
+    double value = var_value(found);
+    if (!(var->flags & IMAGE_CONSTANT) || memcmp(&value, &var->value, sizeof(double)) != 0) {
+      return ARTM_CONST_VAR;
+    }
+  }
+  return ARTM_SUCCESS;
+}
+
+// The formulas are defined once every variable they can read exists
+static artm_status_t restore_vars(artm_calc_t* calc, const image_header_t* header, const char* body) {
+  const image_var_t* vars = (const image_var_t*) body;
+  if (!store_reserve(&calc->decls, calc->decls.count + header->vars)) {
+    return ARTM_ALLOC_ERR;
+  }
+
+  for (size_t i = 0; i < header->vars; ++i) {
+    const image_var_t* in = &vars[i];
+    artm_var_t var = calc_resolve(calc, body + in->name, in->name_size);
+    if (var == NULL)
+      return ARTM_ALLOC_ERR;
+    if (!(in->flags & IMAGE_DEFINED))
+      continue;
+
+    double value;
+    memcpy(&value, &in->value, sizeof(double));
+    graph_clear(var);
+    var->constant = (in->flags & IMAGE_CONSTANT) != 0;
+    var_store(var, value);
+    graph_touch(var);
+  }
+
+  for (size_t i = 0; i < header->vars; ++i) {
+    const image_var_t* in = &vars[i];
+    if (!(in->flags & IMAGE_FORMULA))
+      continue;
+
+    artm_var_t var = calc_find(calc, body + in->name, in->name_size);
+    artm_result_t result = graph_define(var, body + in->source, in->source_size);
+    if (result.status != ARTM_SUCCESS)
+      return result.status;
+  }
+
+  // Expressions cached before the restore may have folded the old constants
+  cache_clear(&calc->cache);
+  return ARTM_SUCCESS;
+}
+
+static artm_status_t write_image(const char* path, image_header_t* header, const char* body) {
+  header->checksum = checksum(body, header->size);
+
+  FILE* file = fopen(path, "wb");
+  bool written = file != NULL
+    && fwrite(header, sizeof(*header), 1, file) == 1
+    && fwrite(body, 1, header->size, file) == header->size;
+  if (file != NULL && fclose(file) != 0)
+    written = false;
+  return written ? ARTM_SUCCESS : ARTM_IO_ERR;
+}
+
+// Maps the file and checks its header and checksum; the caller unmaps it
+static artm_status_t map_image(const char* path, const char* kind, image_header_t* header, char** data, size_t* size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return ARTM_IO_ERR;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return ARTM_IO_ERR;
+  }
+
+  *size = (size_t) info.st_size;
+  if (*size < sizeof(image_header_t)) {
+    close(fd);
+    return ARTM_BAD_FORMAT;
+  }
+
+  *data = (char*) mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (*data == MAP_FAILED) {
+    return ARTM_IO_ERR;
+  }
+
+  memcpy(header, *data, sizeof(*header));
+  if (memcmp(header->magic, kind, sizeof(header->magic)) != 0
+    || header->version != IMAGE_VERSION
+    || header->order != IMAGE_ORDER
+    || header->size != *size - sizeof(*header)
+    || checksum(*data + sizeof(*header), header->size) != header->checksum
+  ) {
+    munmap(*data, *size);
+    return ARTM_BAD_FORMAT;
+  }
+
+  madvise(*data, *size, MADV_SEQUENTIAL);
+  return ARTM_SUCCESS;
+}
+
+// A word at a time; the sections are all multiples of 8 bytes
+static uint64_t checksum(const char* data, size_t size) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (size_t i = 0; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 32;
+  }
+  return hash ^ size;
+}
@@ -0,0 +1,277 @@
+/* JIT - Native x86-64 code generation for compiled programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "calc.h"
+#include "graph.h"
+#include "jit.h"
+#include "result.h"
+
+#if defined(ARTM_JIT) && defined(__x86_64__)
+
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// xmm0-xmm14 hold the evaluation stack and xmm15 is a scratch register
+#define JIT_REGISTERS 15
+#define JIT_SCRATCH 15
+
+// The longest instruction sequence (a load) plus its two failure stubs
+#define JIT_INSTR_SIZE 48
+#define JIT_INSTR_FIXUPS 2
+#define JIT_EPILOGUE_SIZE 16
+
+#define REX_W 0x48
+#define REX_R 0x04
+#define REX_B 0x01
+
+typedef struct emitter emitter_t;
+typedef struct fixup fixup_t;
+
+// A conditional jump to the failure stub of an instruction
+struct fixup {
+  size_t position;
+  size_t index;
+};
+
+struct emitter {
+  uint8_t* code;
+  size_t size;
+  fixup_t* fixups;
+  size_t count;
+};
+
+static void emit_load(emitter_t* emitter, size_t index, artm_var_t var, size_t reg);
+static void emit_stubs(emitter_t* emitter);
+
+static inline void emit_byte(emitter_t* emitter, uint8_t byte) {
+  emitter->code[emitter->size++] = byte;
+}
+
+static inline void emit_bytes(emitter_t* emitter, const void* bytes, size_t size) {
+  memcpy(emitter->code + emitter->size, bytes, size);
+  emitter->size += size;
+}
+
+// movabs rax, imm64
+static inline void emit_imm64(emitter_t* emitter, uint64_t value) {
+  emit_byte(emitter, REX_W);
+  emit_byte(emitter, 0xB8);
+  emit_bytes(emitter, &value, sizeof(value));
+}
+
+static inline void emit_ptr(emitter_t* emitter, const void* pointer) {
+  emit_imm64(emitter, (uint64_t) (uintptr_t) pointer);
+}
+
+// Scalar SSE2 instruction between two xmm registers (or xmm and [rax] if mod is 0)
+static inline void emit_sse(emitter_t* emitter, uint8_t prefix, uint8_t opcode, uint8_t mod, size_t reg, size_t rm) {
+  emit_byte(emitter, prefix);
+  uint8_t rex = (uint8_t) ((reg >= 8 ? REX_R : 0) | (rm >= 8 ? REX_B : 0));
+  if (rex != 0)
+    emit_byte(emitter, 0x40 | rex);
+  emit_byte(emitter, 0x0F);
+  emit_byte(emitter, opcode);
+  emit_byte(emitter, (uint8_t) ((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+}
+
+// movq xmm, rax
+static inline void emit_movq(emitter_t* emitter, size_t reg) {
+  emit_byte(emitter, 0x66);
+  emit_byte(emitter, (uint8_t) (REX_W | (reg >= 8 ? REX_R : 0)));
+  emit_byte(emitter, 0x0F);
+  emit_byte(emitter, 0x6E);
+  emit_byte(emitter, (uint8_t) (0xC0 | ((reg & 7) << 3)));
+}
+
+// cmp byte [rax + offset], 0 followed by a jump to the failure stub
+static inline void emit_check(emitter_t* emitter, size_t offset, uint8_t jump, size_t index) {
+  emit_byte(emitter, 0x80);
+  emit_byte(emitter, 0x78);
+  emit_byte(emitter, (uint8_t) offset);
+  emit_byte(emitter, 0x00);
+  emit_byte(emitter, 0x0F);
+  emit_byte(emitter, jump);
+  emitter->fixups[emitter->count++] = (fixup_t) { emitter->size, index };
+  emit_bytes(emitter, &(int32_t) { 0 }, sizeof(int32_t));
+}
+
+// Functions that are a single instruction
+static inline bool is_inlined(const func_t* func) {
+  return func->kernel == KERNEL_SQRT || func->kernel == KERNEL_ABS;
+}
+
+static inline uint8_t sse_opcode(opcode_t op) {
+  switch (op) {
+    case OP_ADD: return 0x58;
+    case OP_SUB: return 0x5C;
+    case OP_MUL: return 0x59;
+    default: return 0x5E;
+  }
+}
+
+extern bool jit_compile(jit_t* jit, const program_t* program) {
+  if (program->depth > JIT_REGISTERS || program->size == 0)
+    return false;
+
+  // Stores go through artm_var_set to keep the formulas up to date, and
+  // real calls would clobber the stack (every xmm register is caller-saved)
+  for (size_t i = 0; i < program->size; ++i) {
+    const instr_t* instr = &program->code[i];
+    if (instr->op == OP_STORE || (instr->op == OP_CALL && !is_inlined(instr->as.func)))
+      return false;
+  }
+
+  long page = sysconf(_SC_PAGESIZE);
+  size_t size = program->size * JIT_INSTR_SIZE + JIT_EPILOGUE_SIZE;
+  size = (size + (size_t) page - 1) & ~((size_t) page - 1);
+
+  // The page is only ever writable or executable, never both
+  void* code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED)
+    return false;
+
+  emitter_t emitter = { .code = (uint8_t*) code };
+  emitter.fixups = (fixup_t*) alloc_new(program->allocator, program->size * JIT_INSTR_FIXUPS * sizeof(fixup_t));
+  if (emitter.fixups == NULL) {
+    munmap(code, size);
+    return false;
+  }
+
+  size_t top = 0;
+  for (size_t i = 0; i < program->size; ++i) {
+    const instr_t* instr = &program->code[i];
+    switch (instr->op) {
+      case OP_CONST: {
+        uint64_t bits;
+        memcpy(&bits, &instr->as.value, sizeof(bits));
+        emit_imm64(&emitter, bits);
+        emit_movq(&emitter, top++);
+        break;
+      }
+      case OP_LOAD:
+        emit_load(&emitter, i, instr->as.var, top++);
+        break;
+      case OP_NEG:
+        // xorpd with the sign bit, exactly what the compiler does for -x
+        emit_imm64(&emitter, UINT64_C(0x8000000000000000));
+        emit_movq(&emitter, JIT_SCRATCH);
+        emit_sse(&emitter, 0x66, 0x57, 3, top - 1, JIT_SCRATCH);
+        break;
+      case OP_CALL:
+        if (instr->as.func->kernel == KERNEL_SQRT) {
+          emit_sse(&emitter, 0xF2, 0x51, 3, top - 1, top - 1);
+        } else {
+          // andpd with everything but the sign bit
+          emit_imm64(&emitter, UINT64_C(0x7FFFFFFFFFFFFFFF));
+          emit_movq(&emitter, JIT_SCRATCH);
+          emit_sse(&emitter, 0x66, 0x54, 3, top - 1, JIT_SCRATCH);
+        }
+        break;
+      default:
+        --top;
+        emit_sse(&emitter, 0xF2, sse_opcode(instr->op), 3, top - 1, top);
+        break;
+    }
+  }
+
+  // movsd [rdi], xmm0; xor eax, eax; ret
+  emit_bytes(&emitter, (const uint8_t[]) { 0xF2, 0x0F, 0x11, 0x07, 0x31, 0xC0, 0xC3 }, 7);
+  emit_stubs(&emitter);
+  alloc_free(program->allocator, emitter.fixups);
+
+  if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(code, size);
+    return false;
+  }
+
+  // ISO C has no cast from object to function pointers
+  jit->page = code;
+  memcpy(&jit->code, &code, sizeof(jit->code));
+  jit->size = size;
+  return true;
+}
+
+static void emit_load(emitter_t* emitter, size_t index, artm_var_t var, size_t reg) {
+  emit_ptr(emitter, var);
+  emit_check(emitter, offsetof(struct artm_var, defined), 0x84, index);
+  emit_check(emitter, offsetof(struct artm_var, dirty), 0x85, index);
+  emit_sse(emitter, 0xF2, 0x10, 0, reg, 0);
+}
+
+// mov eax, index + 1; ret
+static void emit_stubs(emitter_t* emitter) {
+  for (size_t i = 0; i < emitter->count; ++i) {
+    const fixup_t* fixup = &emitter->fixups[i];
+    int32_t offset = (int32_t) (emitter->size - (fixup->position + sizeof(int32_t)));
+    memcpy(emitter->code + fixup->position, &offset, sizeof(offset));
+
+    uint32_t status = (uint32_t) (fixup->index + 1);
+    emit_byte(emitter, 0xB8);
+    emit_bytes(emitter, &status, sizeof(status));
+    emit_byte(emitter, 0xC3);
+  }
+}
+
+extern void jit_free(jit_t* jit) {
+  if (jit->page != NULL)
+    munmap(jit->page, jit->size);
+  jit_init(jit);
+}
+
+#else
+
+extern bool jit_compile(__attribute__((unused)) jit_t* jit, __attribute__((unused)) const program_t* program) {
+  return false;
+}
+
+extern void jit_free(jit_t* jit) {
+  jit_init(jit);
+}
+
+#endif
+
+extern void jit_init(jit_t* jit) {
+  jit->page = NULL;
+  jit->code = NULL;
+  jit->size = 0;
+}
+
+extern artm_result_t jit_run(const jit_t* jit, const program_t* program) {
+  double value;
+  size_t failed;
+  // Loads of stale formulas bail out, and the code runs again once they are recomputed
+  while ((failed = jit->code(&value)) != 0) {
+    artm_var_t var = program->code[failed - 1].as.var;
+    if (!var_defined(var) || !var->dirty)
+      break;
+    graph_update(var);
+  }
+
+  if (failed == 0)
+    return ARTM_VALUE(value);
+
+  // Only loads bail out, so the variable is undefined
+  return ARTM_ERROR(ARTM_UNDEF_VAR, program->tokens[failed - 1]);
+}
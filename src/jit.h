@@ -0,0 +1,46 @@
+/* JIT - Native x86-64 code generation for compiled programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_JIT_H
+#define ARITHMO_JIT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "arithmo.h"
+#include "program.h"
+
+typedef struct jit jit_t;
+
+// Returns 0 on success or the index + 1 of the instruction that failed
+typedef size_t (*jit_fn_t)(double* result);
+
+struct jit {
+  void* page;
+  jit_fn_t code;
+  size_t size;
+};
+
+extern void jit_init(jit_t* jit);
+extern void jit_free(jit_t* jit);
+
+extern bool jit_compile(jit_t* jit, const program_t* program);
+extern artm_result_t jit_run(const jit_t* jit, const program_t* program);
+
+#endif // ARITHMO_JIT_H
@@ -0,0 +1,260 @@
+/* Kernels - Vectorized arithmetic over blocks of values
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "kernels.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#define KERNEL_VV(_isa_, _attr_, _name_, _op_, _width_, _load_, _store_, _vop_, _set1_) \
+  _attr_ static void _isa_##_##_name_##_vv(double* out, const double* a, const double* b, size_t size) { \
+    size_t i = 0; \
+    for (; i + _width_ <= size; i += _width_) \
+      _store_(out + i, _vop_(_load_(a + i), _load_(b + i))); \
+    for (; i < size; ++i) \
+      out[i] = a[i] _op_ b[i]; \
+  }
+
+#define KERNEL_VS(_isa_, _attr_, _name_, _op_, _width_, _load_, _store_, _vop_, _set1_) \
+  _attr_ static void _isa_##_##_name_##_vs(double* out, const double* a, const double* b, size_t size) { \
+    const double scalar = *b; \
+    size_t i = 0; \
+    for (; i + _width_ <= size; i += _width_) \
+      _store_(out + i, _vop_(_load_(a + i), _set1_(scalar))); \
+    for (; i < size; ++i) \
+      out[i] = a[i] _op_ scalar; \
+  }
+
+#define KERNEL_SV(_isa_, _attr_, _name_, _op_, _width_, _load_, _store_, _vop_, _set1_) \
+  _attr_ static void _isa_##_##_name_##_sv(double* out, const double* a, const double* b, size_t size) { \
+    const double scalar = *a; \
+    size_t i = 0; \
+    for (; i + _width_ <= size; i += _width_) \
+      _store_(out + i, _vop_(_set1_(scalar), _load_(b + i))); \
+    for (; i < size; ++i) \
+      out[i] = scalar _op_ b[i]; \
+  }
+
+#define KERNEL_OP(_isa_, _attr_, _name_, _op_, _width_, _load_, _store_, _vop_, _set1_) \
+  KERNEL_VV(_isa_, _attr_, _name_, _op_, _width_, _load_, _store_, _vop_, _set1_) \
+  KERNEL_VS(_isa_, _attr_, _name_, _op_, _width_, _load_, _store_, _vop_, _set1_) \
+  KERNEL_SV(_isa_, _attr_, _name_, _op_, _width_, _load_, _store_, _vop_, _set1_)
+
+#define KERNEL_NEG(_isa_, _attr_, _width_, _load_, _store_, _vneg_) \
+  _attr_ static void _isa_##_neg(double* out, const double* a, size_t size) { \
+    size_t i = 0; \
+    for (; i + _width_ <= size; i += _width_) \
+      _store_(out + i, _vneg_(_load_(a + i))); \
+    for (; i < size; ++i) \
+      out[i] = -a[i]; \
+  }
+
+#define KERNEL_FUNC1(_isa_, _attr_, _name_, _width_, _load_, _store_, _vfunc_, _func_) \
+  _attr_ static void _isa_##_##_name_(double* out, const double* a, size_t size) { \
+    size_t i = 0; \
+    for (; i + _width_ <= size; i += _width_) \
+      _store_(out + i, _vfunc_(_load_(a + i))); \
+    for (; i < size; ++i) \
+      out[i] = _func_(a[i]); \
+  }
+
+#define KERNEL_FUNC2(_isa_, _attr_, _name_, _width_, _load_, _store_, _vfunc_, _func_) \
+  _attr_ static void _isa_##_##_name_(double* out, const double* a, const double* b, size_t size) { \
+    size_t i = 0; \
+    for (; i + _width_ <= size; i += _width_) \
+      _store_(out + i, _vfunc_(_load_(a + i), _load_(b + i))); \
+    for (; i < size; ++i) \
+      out[i] = _func_(a[i], b[i]); \
+  }
+
+// _funcs_ names a macro that adds the math function kernels of the set
+#define KERNEL_ISA(_isa_, _attr_, _width_, _load_, _store_, _set1_, _add_, _sub_, _mul_, _div_, _neg_, _funcs_) \
+  KERNEL_OP(_isa_, _attr_, add, +, _width_, _load_, _store_, _add_, _set1_) \
+  KERNEL_OP(_isa_, _attr_, sub, -, _width_, _load_, _store_, _sub_, _set1_) \
+  KERNEL_OP(_isa_, _attr_, mul, *, _width_, _load_, _store_, _mul_, _set1_) \
+  KERNEL_OP(_isa_, _attr_, div, /, _width_, _load_, _store_, _div_, _set1_) \
+  KERNEL_NEG(_isa_, _attr_, _width_, _load_, _store_, _neg_) \
+  static const kernels_t _isa_##_kernels = { \
+    .name = #_isa_, \
+    .neg = _isa_##_neg, \
+    .binary = { \
+      [KERNEL_ADD] = { _isa_##_add_vv, _isa_##_add_vs, _isa_##_add_sv }, \
+      [KERNEL_SUB] = { _isa_##_sub_vv, _isa_##_sub_vs, _isa_##_sub_sv }, \
+      [KERNEL_MUL] = { _isa_##_mul_vv, _isa_##_mul_vs, _isa_##_mul_sv }, \
+      [KERNEL_DIV] = { _isa_##_div_vv, _isa_##_div_vs, _isa_##_div_sv } \
+    } \
+    _funcs_(_isa_) \
+  };
+
+// The scalar fallback processes one value per iteration
+#define SCALAR_LOAD(_ptr_) (*(_ptr_))
+#define SCALAR_STORE(_ptr_, _value_) (*(_ptr_) = (_value_))
+#define SCALAR_SET1(_value_) (_value_)
+#define SCALAR_ADD(_a_, _b_) ((_a_) + (_b_))
+#define SCALAR_SUB(_a_, _b_) ((_a_) - (_b_))
+#define SCALAR_MUL(_a_, _b_) ((_a_) * (_b_))
+#define SCALAR_DIV(_a_, _b_) ((_a_) / (_b_))
+#define SCALAR_NEG(_a_) (-(_a_))
+#define SCALAR_FUNCS(_isa_)
+
+KERNEL_ISA(scalar, , 1, SCALAR_LOAD, SCALAR_STORE, SCALAR_SET1,
+  SCALAR_ADD, SCALAR_SUB, SCALAR_MUL, SCALAR_DIV, SCALAR_NEG, SCALAR_FUNCS)
+
+#ifdef KERNELS_X86
+
+#define SSE2_NEG(_a_) _mm_xor_pd((_a_), _mm_set1_pd(-0.0))
+#define AVX2_NEG(_a_) _mm256_xor_pd((_a_), _mm256_set1_pd(-0.0))
+#define AVX512_NEG(_a_) \
+  _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(_a_), _mm512_set1_epi64(INT64_MIN)))
+
+// The operands are kept where the comparison fails, like in kernel_min
+static inline __m128d sse2_abs_pd(__m128d a) {
+  return _mm_andnot_pd(_mm_set1_pd(-0.0), a);
+}
+
+static inline __m128d sse2_min_pd(__m128d a, __m128d b) {
+  __m128d keep = _mm_or_pd(_mm_cmplt_pd(a, b), _mm_cmpunord_pd(b, b));
+  return _mm_or_pd(_mm_and_pd(keep, a), _mm_andnot_pd(keep, b));
+}
+
+static inline __m128d sse2_max_pd(__m128d a, __m128d b) {
+  __m128d keep = _mm_or_pd(_mm_cmpgt_pd(a, b), _mm_cmpunord_pd(b, b));
+  return _mm_or_pd(_mm_and_pd(keep, a), _mm_andnot_pd(keep, b));
+}
+
+__attribute__((target("avx2"))) static inline __m256d avx2_abs_pd(__m256d a) {
+  return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a);
+}
+
+__attribute__((target("avx2"))) static inline __m256d avx2_min_pd(__m256d a, __m256d b) {
+  __m256d keep = _mm256_or_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ), _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+  return _mm256_blendv_pd(b, a, keep);
+}
+
+__attribute__((target("avx2"))) static inline __m256d avx2_max_pd(__m256d a, __m256d b) {
+  __m256d keep = _mm256_or_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ), _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+  return _mm256_blendv_pd(b, a, keep);
+}
+
+__attribute__((target("avx512f"))) static inline __m512d avx512_floor_pd(__m512d a) {
+  return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+__attribute__((target("avx512f"))) static inline __m512d avx512_ceil_pd(__m512d a) {
+  return _mm512_roundscale_pd(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+}
+
+__attribute__((target("avx512f"))) static inline __m512d avx512_min_pd(__m512d a, __m512d b) {
+  __mmask8 keep = _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ) | _mm512_cmp_pd_mask(b, b, _CMP_UNORD_Q);
+  return _mm512_mask_blend_pd(keep, b, a);
+}
+
+__attribute__((target("avx512f"))) static inline __m512d avx512_max_pd(__m512d a, __m512d b) {
+  __mmask8 keep = _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ) | _mm512_cmp_pd_mask(b, b, _CMP_UNORD_Q);
+  return _mm512_mask_blend_pd(keep, b, a);
+}
+
+// Rounding needs SSE4.1, so SSE2 only has the other functions
+KERNEL_FUNC1(sse2, , sqrt, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_sqrt_pd, sqrt)
+KERNEL_FUNC1(sse2, , abs, 2, _mm_loadu_pd, _mm_storeu_pd, sse2_abs_pd, fabs)
+KERNEL_FUNC2(sse2, , min, 2, _mm_loadu_pd, _mm_storeu_pd, sse2_min_pd, kernel_min)
+KERNEL_FUNC2(sse2, , max, 2, _mm_loadu_pd, _mm_storeu_pd, sse2_max_pd, kernel_max)
+
+#define SSE2_FUNCS(_isa_) , \
+  .unary_func = { [KERNEL_SQRT] = _isa_##_sqrt, [KERNEL_ABS] = _isa_##_abs }, \
+  .binary_func = { [KERNEL_MIN] = _isa_##_min, [KERNEL_MAX] = _isa_##_max }
+
+#define AVX2_ATTR __attribute__((target("avx2")))
+KERNEL_FUNC1(avx2, AVX2_ATTR, sqrt, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sqrt_pd, sqrt)
+KERNEL_FUNC1(avx2, AVX2_ATTR, abs, 4, _mm256_loadu_pd, _mm256_storeu_pd, avx2_abs_pd, fabs)
+KERNEL_FUNC1(avx2, AVX2_ATTR, floor, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_floor_pd, floor)
+KERNEL_FUNC1(avx2, AVX2_ATTR, ceil, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_ceil_pd, ceil)
+KERNEL_FUNC2(avx2, AVX2_ATTR, min, 4, _mm256_loadu_pd, _mm256_storeu_pd, avx2_min_pd, kernel_min)
+KERNEL_FUNC2(avx2, AVX2_ATTR, max, 4, _mm256_loadu_pd, _mm256_storeu_pd, avx2_max_pd, kernel_max)
+
+#define AVX512_ATTR __attribute__((target("avx512f")))
+KERNEL_FUNC1(avx512, AVX512_ATTR, sqrt, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_sqrt_pd, sqrt)
+KERNEL_FUNC1(avx512, AVX512_ATTR, abs, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_abs_pd, fabs)
+KERNEL_FUNC1(avx512, AVX512_ATTR, floor, 8, _mm512_loadu_pd, _mm512_storeu_pd, avx512_floor_pd, floor)
+KERNEL_FUNC1(avx512, AVX512_ATTR, ceil, 8, _mm512_loadu_pd, _mm512_storeu_pd, avx512_ceil_pd, ceil)
+KERNEL_FUNC2(avx512, AVX512_ATTR, min, 8, _mm512_loadu_pd, _mm512_storeu_pd, avx512_min_pd, kernel_min)
+KERNEL_FUNC2(avx512, AVX512_ATTR, max, 8, _mm512_loadu_pd, _mm512_storeu_pd, avx512_max_pd, kernel_max)
+
+#define ROUNDING_FUNCS(_isa_) , \
+  .unary_func = { \
+    [KERNEL_SQRT] = _isa_##_sqrt, [KERNEL_ABS] = _isa_##_abs, \
+    [KERNEL_FLOOR] = _isa_##_floor, [KERNEL_CEIL] = _isa_##_ceil \
+  }, \
+  .binary_func = { [KERNEL_MIN] = _isa_##_min, [KERNEL_MAX] = _isa_##_max }
+
+KERNEL_ISA(sse2, , 2, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd,
+  _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd, SSE2_NEG, SSE2_FUNCS)
+
+KERNEL_ISA(avx2, AVX2_ATTR, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+  _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd, AVX2_NEG, ROUNDING_FUNCS)
+
+KERNEL_ISA(avx512, AVX512_ATTR, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd,
+  _mm512_add_pd, _mm512_sub_pd, _mm512_mul_pd, _mm512_div_pd, AVX512_NEG, ROUNDING_FUNCS)
+
+#endif
+
+static bool supported(const kernels_t* kernels) {
+#ifdef KERNELS_X86
+  if (kernels == &avx512_kernels)
+    return __builtin_cpu_supports("avx512f");
+  if (kernels == &avx2_kernels)
+    return __builtin_cpu_supports("avx2");
+#endif
+  return kernels != NULL;
+}
+
+// Ordered from the most to the least preferred kernels
+static const kernels_t* const available[] = {
+#ifdef KERNELS_X86
+  &avx512_kernels,
+  &avx2_kernels,
+  &sse2_kernels,
+#endif
+  &scalar_kernels
+};
+
+extern const kernels_t* kernels_select(void) {
+  size_t count = sizeof(available) / sizeof(available[0]);
+  for (size_t i = 0; i < count - 1; ++i) {
+    if (supported(available[i]))
+      return available[i];
+  }
+  return &scalar_kernels;
+}
+
+extern const kernels_t* kernels_find(const char* name) {
+  size_t count = sizeof(available) / sizeof(available[0]);
+  for (size_t i = 0; i < count; ++i) {
+    if (strcmp(available[i]->name, name) == 0)
+      return supported(available[i]) ? available[i] : NULL;
+  }
+  return NULL;
+}
@@ -0,0 +1,81 @@
+/* Kernels - Vectorized arithmetic over blocks of values
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_KERNELS_H
+#define ARITHMO_KERNELS_H
+
+#include <stddef.h>
+#include <math.h>
+
+typedef struct kernels kernels_t;
+typedef void (*kernel_unary_t)(double* out, const double* a, size_t size);
+typedef void (*kernel_binary_t)(double* out, const double* a, const double* b, size_t size);
+
+typedef enum {
+  KERNEL_ADD,
+  KERNEL_SUB,
+  KERNEL_MUL,
+  KERNEL_DIV,
+  KERNEL_OPS
+} kernel_op_t;
+
+// Operand shapes: vector-vector, vector-scalar (b[0]) and scalar (a[0])-vector
+typedef enum {
+  KERNEL_VV,
+  KERNEL_VS,
+  KERNEL_SV,
+  KERNEL_SHAPES
+} kernel_shape_t;
+
+// Math functions with exact SIMD versions (same bits as the scalar ones)
+typedef enum {
+  KERNEL_SQRT,
+  KERNEL_ABS,
+  KERNEL_FLOOR,
+  KERNEL_CEIL,
+  KERNEL_MIN,
+  KERNEL_MAX,
+  KERNEL_FUNCS,
+  KERNEL_NONE = KERNEL_FUNCS
+} kernel_func_t;
+
+// Functions that an instruction set can't compute exactly are NULL, and the
+// callers fall back to the scalar version for every row
+struct kernels {
+  const char* name;
+  kernel_unary_t neg;
+  kernel_binary_t binary[KERNEL_OPS][KERNEL_SHAPES];
+  kernel_unary_t unary_func[KERNEL_FUNCS];
+  kernel_binary_t binary_func[KERNEL_FUNCS];
+};
+
+// The exact semantics of the SIMD min and max instructions, plus the NaN
+// handling of fmin and fmax: a NaN operand is ignored if the other one isn't
+static inline double kernel_min(double a, double b) {
+  return a < b || isnan(b) ? a : b;
+}
+
+static inline double kernel_max(double a, double b) {
+  return a > b || isnan(b) ? a : b;
+}
+
+extern const kernels_t* kernels_select(void);
+extern const kernels_t* kernels_find(const char* name);
+
+#endif // ARITHMO_KERNELS_H
@@ -17,10 +17,14 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #include "lexer.h"
+#include "number.h"
+
+// Bigger exponents overflow (or underflow) whatever the mantissa is
+#define LEXER_MAX_EXPONENT 100000
 
 static void skip_spaces(lexer_t* lexer);
 
@@ -30,11 +34,11 @@ static token_t number_token(lexer_t* lexer);
 static token_t base_token(lexer_t* lexer);
 
 static inline bool at_end(const lexer_t* lexer) {
-  return *lexer->current == '\0';
+  return lexer->current == lexer->end;
 }
 
 static inline bool is_space(const lexer_t* lexer) {
-  return *lexer->current == ' ';
+  return *lexer->current == ' ' || *lexer->current == '\t' || *lexer->current == '\r';
 }
 
 static inline bool is_digit(const lexer_t* lexer) {
@@ -51,15 +55,44 @@ static inline bool is_alphanum(const lexer_t* lexer) {
   return is_digit(lexer) || is_alpha(lexer);
 }
 
+// An exponent is only part of the number if it has at least one digit
+static inline bool is_exponent(const lexer_t* lexer) {
+  const char* current = lexer->current;
+  if (current == lexer->end || (*current != 'e' && *current != 'E'))
+    return false;
+
+  if (++current != lexer->end && (*current == '-' || *current == '+'))
+    ++current;
+  return current != lexer->end && *current >= '0' && *current <= '9';
+}
+
+// Leading zeros are not significant, and the digits past the mantissa
+// capacity only move the exponent (digits is the count of significant ones)
+static inline void add_digit(number_t* number, size_t* digits, char digit, int64_t shift) {
+  if (*digits < NUMBER_MAX_DIGITS) {
+    number->mantissa = number->mantissa * 10 + (uint64_t) (digit - '0');
+    number->exponent += shift;
+    if (number->mantissa != 0)
+      ++*digits;
+  } else {
+    number->truncated = number->truncated || digit != '0';
+    number->exponent += shift + 1;
+  }
+}
+
 static inline token_t make_token(lexer_t* lexer, token_type_t type) {
-  return (token_t) { type, lexer->start, lexer->current - lexer->start };
+  return (token_t) { type, lexer->start, lexer->current - lexer->start, 0 };
 }
 
-extern void lexer_init(lexer_t* lexer, const char* expression) {
+extern void lexer_init(lexer_t* lexer, const char* expression, size_t size) {
   lexer->current = lexer->start = expression;
+  lexer->end = expression + size;
+  lexer->separators = false;
+  STATS(lexer->tokens = 0;)
 }
 
 extern token_t lexer_next(lexer_t* lexer) {
+  STATS(++lexer->tokens;)
   while (!at_end(lexer)) {
     if (is_space(lexer)) {
       skip_spaces(lexer);
@@ -72,6 +105,16 @@ extern token_t lexer_next(lexer_t* lexer) {
   return make_token(lexer, TKN_END);
 }
 
+// Without separators the whole text is a single statement
+extern const char* lexer_statement_end(const lexer_t* lexer, const char* from) {
+  if (!lexer->separators)
+    return lexer->end;
+
+  while (from != lexer->end && *from != ';' && *from != '\n')
+    ++from;
+  return from;
+}
+
 static token_t lang_token(lexer_t* lexer) {
   lexer->start = lexer->current;
   if (is_alpha(lexer))
@@ -81,16 +124,38 @@ static token_t lang_token(lexer_t* lexer) {
   return base_token(lexer);
 }
 
+// The digits are accumulated into the mantissa while they are scanned, so
+// the number is never read a second time to convert it
 static token_t number_token(lexer_t* lexer) {
-  while (!at_end(lexer) && is_digit(lexer))
+  number_t number = { 0 };
+  size_t digits = 0;
+
+  for (; !at_end(lexer) && is_digit(lexer); ++lexer->current)
+    add_digit(&number, &digits, *lexer->current, 0);
+
+  if (!at_end(lexer) && *lexer->current == '.') {
     ++lexer->current;
+    for (; !at_end(lexer) && is_digit(lexer); ++lexer->current)
+      add_digit(&number, &digits, *lexer->current, -1);
+  }
 
-  if (*lexer->current == '.') {
+  if (is_exponent(lexer)) {
     ++lexer->current;
-    while (!at_end(lexer) && is_digit(lexer))
+    bool negative = *lexer->current == '-';
+    if (*lexer->current == '-' || *lexer->current == '+')
       ++lexer->current;
+
+    int64_t exponent = 0;
+    for (; !at_end(lexer) && is_digit(lexer); ++lexer->current) {
+      if (exponent < LEXER_MAX_EXPONENT)
+        exponent = exponent * 10 + (*lexer->current - '0');
+    }
+    number.exponent += negative ? -exponent : exponent;
   }
-  return make_token(lexer, TKN_NUMBER);
+
+  token_t token = make_token(lexer, TKN_NUMBER);
+  token.value = number_value(&number, token.target, token.size);
+  return token;
 }
 
 static token_t id_token(lexer_t* lexer) {
@@ -109,8 +174,17 @@ static token_t base_token(lexer_t* lexer) {
     case '/': return make_token(lexer, TKN_SLASH);
     case '(': return make_token(lexer, TKN_LPAREN);
     case ')': return make_token(lexer, TKN_RPAREN);
+    case ',': return make_token(lexer, TKN_COMMA);
     case '$': return make_token(lexer, TKN_DOLLAR);
     case '=': return make_token(lexer, TKN_EQUAL);
+    case ';':
+    case '\n':
+      return make_token(lexer, lexer->separators ? TKN_SEMI : TKN_ERROR);
+    case ':':
+      if (at_end(lexer) || *lexer->current != '=')
+        return make_token(lexer, TKN_ERROR);
+      ++lexer->current;
+      return make_token(lexer, TKN_DEFINE);
     default: return make_token(lexer, TKN_ERROR);
   }
 }
@@ -21,17 +21,23 @@
 #define ARITHMO_LEXER_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 #include "token.h"
+#include "stats.h"
 
 typedef struct lexer lexer_t;
 
 struct lexer {
   const char* current;
   const char* start;
+  const char* end;
+  bool separators;
+  STATS(size_t tokens;)
 };
 
-extern void lexer_init(lexer_t* lexer, const char* expression);
+extern void lexer_init(lexer_t* lexer, const char* expression, size_t size);
 extern token_t lexer_next(lexer_t* lexer);
+extern const char* lexer_statement_end(const lexer_t* lexer, const char* from);
 
 #endif // ARITHMO_LEXER_H
@@ -0,0 +1,41 @@
+/* Number - Correctly rounded decimal to double conversion
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_NUMBER_H
+#define ARITHMO_NUMBER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NUMBER_MAX_DIGITS 19
+
+typedef struct number number_t;
+
+// A decimal number scanned by the lexer: mantissa * 10^exponent, where the
+// mantissa holds at most NUMBER_MAX_DIGITS significant digits
+struct number {
+  uint64_t mantissa;
+  int64_t exponent;
+  bool truncated;
+};
+
+extern double number_value(const number_t* number, const char* text, size_t size);
+
+#endif // ARITHMO_NUMBER_H
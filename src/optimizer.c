@@ -0,0 +1,272 @@
+/* Optimizer - Constant folding and algebraic simplification of programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "arithmo.h"
+#include "calc.h"
+#include "optimizer.h"
+
+typedef struct operand operand_t;
+typedef struct optimizer optimizer_t;
+
+// Mirrors the evaluation stack: where the code of every operand starts in
+// the optimized program and whether it is a known constant
+struct operand {
+  size_t start;
+  bool constant;
+  double value;
+};
+
+struct optimizer {
+  program_t* program;
+  unsigned flags;
+  operand_t* stack;
+  size_t top;
+  size_t size;
+};
+
+typedef enum {
+  REWRITE_NONE,
+  REWRITE_DROP,
+  REWRITE_NEGATE,
+  REWRITE_ZERO,
+  REWRITE_RECIPROCAL
+} rewrite_t;
+
+static void optimize_neg(optimizer_t* opt, const instr_t* instr, const token_t* token);
+static void optimize_binary(optimizer_t* opt, const instr_t* instr, const token_t* token);
+static void optimize_call(optimizer_t* opt, const instr_t* instr, const token_t* token);
+static rewrite_t rewrite_right(opcode_t op, double value, unsigned flags);
+static rewrite_t rewrite_left(opcode_t op, double value, unsigned flags);
+
+static inline void put(optimizer_t* opt, instr_t instr, token_t token) {
+  opt->program->code[opt->size] = instr;
+  opt->program->tokens[opt->size] = token;
+  ++opt->size;
+}
+
+static inline void put_const(optimizer_t* opt, operand_t* operand, double value, token_t token) {
+  opt->size = operand->start;
+  put(opt, (instr_t) { .op = OP_CONST, .as = { .value = value } }, token);
+  *operand = (operand_t) { operand->start, true, value };
+}
+
+static inline double apply(opcode_t op, double a, double b) {
+  switch (op) {
+    case OP_ADD: return a + b;
+    case OP_SUB: return a - b;
+    case OP_MUL: return a * b;
+    default: return a / b;
+  }
+}
+
+static inline bool is_zero(double value, bool negative) {
+  return value == 0 && (signbit(value) != 0) == negative;
+}
+
+extern bool optimize(program_t* program, unsigned flags) {
+  optimizer_t opt = { .program = program, .flags = flags };
+  opt.stack = (operand_t*) alloc_new(program->allocator, (program->depth + 1) * sizeof(operand_t));
+  if (opt.stack == NULL)
+    return false;
+
+  // The optimized code is never longer than the original one, so it is
+  // written over it as the original instructions are read
+  for (size_t i = 0; i < program->size; ++i) {
+    instr_t instr = program->code[i];
+    token_t token = program->tokens[i];
+
+    switch (instr.op) {
+      case OP_LOAD:
+        if (!instr.as.var->constant) {
+          opt.stack[opt.top++] = (operand_t) { opt.size, false, 0 };
+          put(&opt, instr, token);
+          break;
+        }
+        instr = (instr_t) { .op = OP_CONST, .as = { .value = var_value(instr.as.var) } };
+        // fall through
+      case OP_CONST:
+        opt.stack[opt.top++] = (operand_t) { opt.size, true, instr.as.value };
+        put(&opt, instr, token);
+        break;
+      case OP_STORE:
+        put(&opt, instr, token);
+        break;
+      case OP_NEG:
+        optimize_neg(&opt, &instr, &token);
+        break;
+      case OP_CALL:
+        optimize_call(&opt, &instr, &token);
+        break;
+      default:
+        optimize_binary(&opt, &instr, &token);
+        break;
+    }
+  }
+
+  program->size = opt.size;
+  program_measure(program);
+  alloc_free(program->allocator, opt.stack);
+  return true;
+}
+
+static void optimize_neg(optimizer_t* opt, const instr_t* instr, const token_t* token) {
+  operand_t* a = &opt->stack[opt->top - 1];
+  if (a->constant) {
+    put_const(opt, a, -a->value, *token);
+    return;
+  }
+
+  // -(-x) is x for every value
+  if (opt->program->code[opt->size - 1].op == OP_NEG) {
+    --opt->size;
+    return;
+  }
+  put(opt, *instr, *token);
+}
+
+static void optimize_binary(optimizer_t* opt, const instr_t* instr, const token_t* token) {
+  operand_t b = opt->stack[--opt->top];
+  operand_t* a = &opt->stack[opt->top - 1];
+  program_t* program = opt->program;
+
+  if (a->constant && b.constant) {
+    put_const(opt, a, apply(instr->op, a->value, b.value), *token);
+    return;
+  }
+
+  if (b.constant) {
+    switch (rewrite_right(instr->op, b.value, opt->flags)) {
+      case REWRITE_DROP:
+        opt->size = b.start;
+        return;
+      case REWRITE_NEGATE:
+        opt->size = b.start;
+        optimize_neg(opt, &(instr_t) { .op = OP_NEG }, token);
+        return;
+      case REWRITE_ZERO:
+        put_const(opt, a, 0, *token);
+        return;
+      case REWRITE_RECIPROCAL:
+        program->code[b.start].as.value = 1 / b.value;
+        put(opt, (instr_t) { .op = OP_MUL }, *token);
+        return;
+      default: break;
+    }
+  }
+
+  if (a->constant) {
+    switch (rewrite_left(instr->op, a->value, opt->flags)) {
+      case REWRITE_DROP:
+      case REWRITE_NEGATE: {
+        // The constant is a single instruction in front of the other operand
+        size_t rest = opt->size - a->start - 1;
+        memmove(&program->code[a->start], &program->code[a->start + 1], rest * sizeof(instr_t));
+        memmove(&program->tokens[a->start], &program->tokens[a->start + 1], rest * sizeof(token_t));
+        --opt->size;
+        a->constant = false;
+        if (rewrite_left(instr->op, a->value, opt->flags) == REWRITE_NEGATE)
+          optimize_neg(opt, &(instr_t) { .op = OP_NEG }, token);
+        return;
+      }
+      case REWRITE_ZERO:
+        put_const(opt, a, 0, *token);
+        return;
+      default: break;
+    }
+  }
+
+  a->constant = false;
+  put(opt, *instr, *token);
+}
+
+// Pure functions of constants are computed once, here
+static void optimize_call(optimizer_t* opt, const instr_t* instr, const token_t* token) {
+  const func_t* func = instr->as.func;
+  opt->top -= func->arity;
+  operand_t* args = &opt->stack[opt->top];
+  operand_t* result = &opt->stack[opt->top++];
+
+  bool constant = (func->flags & FUNC_PURE) != 0;
+  double values[FUNC_MAX_ARITY];
+  for (size_t i = 0; i < func->arity; ++i) {
+    constant = constant && args[i].constant;
+    values[i] = args[i].value;
+  }
+
+  size_t start = func->arity > 0 ? args[0].start : opt->size;
+  if (constant) {
+    *result = (operand_t) { start, true, 0 };
+    put_const(opt, result, func_call(func, values), *token);
+    return;
+  }
+
+  *result = (operand_t) { start, false, 0 };
+  put(opt, *instr, *token);
+}
+
+// A division by a power of two is exactly a multiplication by its reciprocal
+static bool has_exact_reciprocal(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint64_t exponent = (bits >> 52) & 0x7FF;
+  return (bits & 0xFFFFFFFFFFFFFULL) == 0 && exponent >= 1 && exponent <= 2045;
+}
+
+// Rewrites of "x op value"; only the ones that give the same bits for every
+// value of x unless ARTM_OPT_FAST_MATH is set (x * -1 flips the sign of NaN)
+static rewrite_t rewrite_right(opcode_t op, double value, unsigned flags) {
+  bool fast = (flags & ARTM_OPT_FAST_MATH) != 0;
+  switch (op) {
+    case OP_ADD:
+      return is_zero(value, true) || (fast && value == 0) ? REWRITE_DROP : REWRITE_NONE;
+    case OP_SUB:
+      return is_zero(value, false) || (fast && value == 0) ? REWRITE_DROP : REWRITE_NONE;
+    case OP_MUL:
+      if (value == 1) return REWRITE_DROP;
+      if (fast && value == -1) return REWRITE_NEGATE;
+      return fast && value == 0 ? REWRITE_ZERO : REWRITE_NONE;
+    default:
+      if (value == 1) return REWRITE_DROP;
+      if (fast && value == -1) return REWRITE_NEGATE;
+      return has_exact_reciprocal(value) ? REWRITE_RECIPROCAL : REWRITE_NONE;
+  }
+}
+
+// Rewrites of "value op x", with the same rules as above
+static rewrite_t rewrite_left(opcode_t op, double value, unsigned flags) {
+  bool fast = (flags & ARTM_OPT_FAST_MATH) != 0;
+  switch (op) {
+    case OP_ADD:
+      return is_zero(value, true) || (fast && value == 0) ? REWRITE_DROP : REWRITE_NONE;
+    case OP_SUB:
+      return fast && value == 0 ? REWRITE_NEGATE : REWRITE_NONE;
+    case OP_MUL:
+      if (value == 1) return REWRITE_DROP;
+      if (fast && value == -1) return REWRITE_NEGATE;
+      return fast && value == 0 ? REWRITE_ZERO : REWRITE_NONE;
+    default:
+      return fast && value == 0 ? REWRITE_ZERO : REWRITE_NONE;
+  }
+}
@@ -0,0 +1,29 @@
+/* Optimizer - Constant folding and algebraic simplification of programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_OPTIMIZER_H
+#define ARITHMO_OPTIMIZER_H
+
+#include <stdbool.h>
+
+#include "program.h"
+
+extern bool optimize(program_t* program, unsigned flags);
+
+#endif // ARITHMO_OPTIMIZER_H
@@ -0,0 +1,397 @@
+/* Parser - Iterative math expression parser
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "calc.h"
+#include "graph.h"
+#include "parser.h"
+#include "result.h"
+
+#define PARSER_EMIT(_parser_, _instr_, _token_) \
+  do { \
+    if (!program_emit(_parser_->program, _instr_, _token_)) { \
+      return ARTM_ERROR(ARTM_ALLOC_ERR, _token_); \
+    } \
+  } while (0)
+
+static artm_result_t push_frame(parser_t* parser, parser_frame_type_t type, const token_t* token);
+static artm_result_t push_arg(parser_t* parser, double value, const token_t* token);
+static artm_result_t constant(parser_t* parser, const token_t* token, double* value);
+static artm_result_t load(parser_t* parser, const token_t* id, double* value);
+static artm_result_t negate(parser_t* parser, const token_t* token, double* value);
+static artm_result_t operate(parser_t* parser, const token_t* token, double left, double* value);
+static artm_result_t open_call(parser_t* parser, const token_t* id, const parser_level_t* level);
+static artm_result_t close_call(parser_t* parser, parser_level_t* level, double* value);
+static bool grow(parser_t* parser, void** items, size_t* capacity, void* inline_items, size_t count, size_t size, parser_block_t* spare);
+static void give_back(parser_t* parser, void* items, const void* inline_items, size_t capacity, parser_block_t* spare);
+
+static const parser_level_t empty_level = { .add = { .type = TKN_END }, .mul = { .type = TKN_END } };
+
+static inline parser_frame_t* top_frame(parser_t* parser) {
+  return &parser->frames.items[parser->frames.count - 1];
+}
+
+static inline bool borrow(parser_t* parser) {
+  if (!parser->borrowed)
+    parser->borrowed = !atomic_flag_test_and_set_explicit(&parser->calc->spare.busy, memory_order_acquire);
+  return parser->borrowed;
+}
+
+extern void parser_init(parser_t* parser, artm_calc_t* calc, const char* expression, size_t size) {
+  parser->calc = calc;
+  parser->program = NULL;
+  parser->resolve = false;
+  parser->borrowed = false;
+  parser->max_depth = calc->max_depth;
+  lexer_init(&parser->lexer, expression, size);
+  parser->token = (token_t) { .type = TKN_END };
+  parser->frames.items = parser->frames.inline_items;
+  parser->frames.count = 0;
+  parser->frames.capacity = PARSER_INLINE_SIZE;
+  parser->args.items = parser->args.inline_items;
+  parser->args.count = 0;
+  parser->args.capacity = PARSER_INLINE_SIZE;
+}
+
+extern void parser_free(parser_t* parser) {
+  parser_spare_t* spare = &parser->calc->spare;
+  give_back(parser, parser->frames.items, parser->frames.inline_items, parser->frames.capacity, &spare->frames);
+  give_back(parser, parser->args.items, parser->args.inline_items, parser->args.capacity, &spare->args);
+  if (parser->borrowed)
+    atomic_flag_clear_explicit(&spare->busy, memory_order_release);
+}
+
+extern void parser_spare_init(parser_spare_t* spare) {
+  atomic_flag_clear(&spare->busy);
+  spare->frames = spare->args = (parser_block_t) { NULL, 0 };
+}
+
+extern void parser_spare_free(parser_spare_t* spare, const artm_allocator_t* allocator) {
+  alloc_free(allocator, spare->frames.items);
+  alloc_free(allocator, spare->args.items);
+  parser_spare_init(spare);
+}
+
+// The same grammar as recursive descent, with the C stack replaced by the
+// frames: a parenthesis, call or unary minus pushes one (up to max_depth),
+// while the sums and products of the current level stay in locals. The
+// operators are applied (or emitted) in the same order, so the results
+// and errors do not change
+extern artm_result_t parser_expr(parser_t* parser) {
+  size_t base = parser->frames.count;
+  parser_level_t level = empty_level;
+  double value = 0;
+  artm_result_t result;
+
+  for (;;) {
+    token_t token = parser->token;
+    switch (token.type) {
+      case TKN_NUMBER:
+        result = constant(parser, &token, &value);
+        ARTM_CHECK_RESULT(result);
+        PARSER_ADVANCE(parser);
+        break;
+      case TKN_MINUS:
+        result = push_frame(parser, FRAME_NEG, &token);
+        ARTM_CHECK_RESULT(result);
+        PARSER_ADVANCE(parser);
+        continue;
+      case TKN_PLUS:
+        PARSER_ADVANCE(parser);
+        continue;
+      case TKN_LPAREN:
+        result = push_frame(parser, FRAME_PAREN, &token);
+        ARTM_CHECK_RESULT(result);
+        top_frame(parser)->level = level;
+        level = empty_level;
+        PARSER_ADVANCE(parser);
+        continue;
+      case TKN_ID:
+        PARSER_ADVANCE(parser);
+        if (parser->token.type != TKN_LPAREN) {
+          result = load(parser, &token, &value);
+          ARTM_CHECK_RESULT(result);
+          break;
+        }
+
+        result = open_call(parser, &token, &level);
+        ARTM_CHECK_RESULT(result);
+        level = empty_level;
+        if (top_frame(parser)->func->arity > 0)
+          continue;
+
+        result = close_call(parser, &level, &value);
+        ARTM_CHECK_RESULT(result);
+        break;
+      default:
+        return ARTM_ERROR(ARTM_INV_TOKEN, token);
+    }
+
+    // The operand is complete, so everything it was the last one of is too
+    for (;;) {
+      while (parser->frames.count > base && top_frame(parser)->type == FRAME_NEG) {
+        result = negate(parser, &top_frame(parser)->token, &value);
+        ARTM_CHECK_RESULT(result);
+        --parser->frames.count;
+      }
+
+      if (level.mul.type != TKN_END) {
+        result = operate(parser, &level.mul, level.product, &value);
+        ARTM_CHECK_RESULT(result);
+        level.mul.type = TKN_END;
+      }
+
+      token = parser->token;
+      if (token.type == TKN_STAR || token.type == TKN_SLASH) {
+        level.product = value;
+        level.mul = token;
+        PARSER_ADVANCE(parser);
+        break;
+      }
+
+      if (level.add.type != TKN_END) {
+        result = operate(parser, &level.add, level.sum, &value);
+        ARTM_CHECK_RESULT(result);
+        level.add.type = TKN_END;
+      }
+
+      if (token.type == TKN_PLUS || token.type == TKN_MINUS) {
+        level.sum = value;
+        level.add = token;
+        PARSER_ADVANCE(parser);
+        break;
+      }
+
+      // Anything else ends the innermost parenthesis, argument or the expression
+      if (parser->frames.count == base)
+        return ARTM_VALUE(value);
+
+      parser_frame_t* frame = top_frame(parser);
+      if (frame->type == FRAME_PAREN) {
+        PARSER_CONSUME(parser, TKN_RPAREN, ARTM_INV_TOKEN);
+        level = frame->level;
+        --parser->frames.count;
+        continue;
+      }
+
+      result = push_arg(parser, value, &frame->token);
+      ARTM_CHECK_RESULT(result);
+      if (++frame->args < frame->func->arity) {
+        PARSER_CONSUME(parser, TKN_COMMA, ARTM_INV_TOKEN);
+        break;
+      }
+
+      result = close_call(parser, &level, &value);
+      ARTM_CHECK_RESULT(result);
+    }
+  }
+}
+
+extern artm_result_t parser_emit_named(parser_t* parser, opcode_t op, token_t id) {
+  // Without resolve the calc is only read, so unknown names are errors
+  artm_var_t var = parser->resolve
+    ? calc_resolve(parser->calc, id.target, id.size)
+    : calc_find(parser->calc, id.target, id.size);
+  if (var == NULL) {
+    return ARTM_ERROR(parser->resolve ? ARTM_ALLOC_ERR : ARTM_UNDEF_VAR, id);
+  }
+
+  instr_t instr = { .op = op, .as = { .var = var } };
+
+  if (op == OP_STORE && instr.as.var->constant) {
+    return ARTM_ERROR(ARTM_CONST_VAR, id);
+  }
+
+  PARSER_EMIT(parser, instr, id);
+  return ARTM_VALUE(0);
+}
+
+static artm_result_t push_frame(parser_t* parser, parser_frame_type_t type, const token_t* token) {
+  if (parser->frames.count >= parser->max_depth) {
+    return ARTM_ERROR(ARTM_TOO_DEEP, *token);
+  }
+
+  if (parser->frames.count == parser->frames.capacity) {
+    void* items = parser->frames.items;
+    if (!grow(parser, &items, &parser->frames.capacity, parser->frames.inline_items, parser->frames.count,
+      sizeof(parser_frame_t), &parser->calc->spare.frames))
+      return ARTM_ERROR(ARTM_ALLOC_ERR, *token);
+    parser->frames.items = (parser_frame_t*) items;
+  }
+
+  parser_frame_t* frame = &parser->frames.items[parser->frames.count++];
+  frame->type = type;
+  frame->token = *token;
+  frame->func = NULL;
+  frame->args = 0;
+  return ARTM_VALUE(0);
+}
+
+// Only the interpreter keeps the arguments, the compiler leaves them to the program
+static artm_result_t push_arg(parser_t* parser, double value, const token_t* token) {
+  if (parser->program != NULL) {
+    return ARTM_VALUE(0);
+  }
+
+  if (parser->args.count == parser->args.capacity) {
+    void* items = parser->args.items;
+    if (!grow(parser, &items, &parser->args.capacity, parser->args.inline_items, parser->args.count,
+      sizeof(double), &parser->calc->spare.args))
+      return ARTM_ERROR(ARTM_ALLOC_ERR, *token);
+    parser->args.items = (double*) items;
+  }
+
+  parser->args.items[parser->args.count++] = value;
+  return ARTM_VALUE(0);
+}
+
+static artm_result_t constant(parser_t* parser, const token_t* token, double* value) {
+  if (parser->program != NULL) {
+    instr_t instr = { .op = OP_CONST, .as = { .value = token->value } };
+    PARSER_EMIT(parser, instr, *token);
+    return ARTM_VALUE(0);
+  }
+
+  *value = token->value;
+  return ARTM_VALUE(0);
+}
+
+static artm_result_t load(parser_t* parser, const token_t* id, double* value) {
+  if (parser->program != NULL) {
+    return parser_emit_named(parser, OP_LOAD, *id);
+  }
+
+  artm_var_t var = calc_find(parser->calc, id->target, id->size);
+  if (var == NULL || !var_defined(var)) {
+    return ARTM_ERROR(ARTM_UNDEF_VAR, *id);
+  }
+
+  if (var->dirty) {
+    graph_update(var);
+  }
+  *value = var_value(var);
+  return ARTM_VALUE(0);
+}
+
+static artm_result_t negate(parser_t* parser, const token_t* token, double* value) {
+  if (parser->program != NULL) {
+    PARSER_EMIT(parser, ((instr_t) { .op = OP_NEG }), *token);
+    return ARTM_VALUE(0);
+  }
+
+  *value = -*value;
+  return ARTM_VALUE(0);
+}
+
+static artm_result_t operate(parser_t* parser, const token_t* token, double left, double* value) {
+  if (parser->program != NULL) {
+    opcode_t op = token->type == TKN_PLUS ? OP_ADD
+      : token->type == TKN_MINUS ? OP_SUB
+      : token->type == TKN_STAR ? OP_MUL
+      : OP_DIV;
+    PARSER_EMIT(parser, ((instr_t) { .op = op }), *token);
+    return ARTM_VALUE(0);
+  }
+
+  switch (token->type) {
+    case TKN_PLUS: *value = left + *value; break;
+    case TKN_MINUS: *value = left - *value; break;
+    case TKN_STAR: *value = left * *value; break;
+    default: *value = left / *value; break;
+  }
+  return ARTM_VALUE(0);
+}
+
+// The current token is the opening parenthesis
+static artm_result_t open_call(parser_t* parser, const token_t* id, const parser_level_t* level) {
+  const func_t* func = calc_func(parser->calc, id->target, id->size);
+  if (func == NULL) {
+    return ARTM_ERROR(ARTM_UNDEF_FN, *id);
+  }
+
+  artm_result_t result = push_frame(parser, FRAME_CALL, id);
+  ARTM_CHECK_RESULT(result);
+
+  parser_frame_t* frame = top_frame(parser);
+  frame->func = func;
+  frame->level = *level;
+  PARSER_ADVANCE(parser);
+  return ARTM_VALUE(0);
+}
+
+// The function is called once its closing parenthesis is consumed
+static artm_result_t close_call(parser_t* parser, parser_level_t* level, double* value) {
+  PARSER_CONSUME(parser, TKN_RPAREN, ARTM_INV_TOKEN);
+
+  const parser_frame_t* frame = top_frame(parser);
+  *level = frame->level;
+  --parser->frames.count;
+
+  if (parser->program != NULL) {
+    instr_t instr = { .op = OP_CALL, .as = { .func = frame->func } };
+    PARSER_EMIT(parser, instr, frame->token);
+    return ARTM_VALUE(0);
+  }
+
+  parser->args.count -= frame->func->arity;
+  *value = func_call(frame->func, &parser->args.items[parser->args.count]);
+  return ARTM_VALUE(0);
+}
+
+// A stack that outgrows its inline items first tries the spare block of
+// the calc, so that repeated deep expressions don't allocate every time
+static bool grow(parser_t* parser, void** items, size_t* capacity, void* inline_items, size_t count, size_t size, parser_block_t* spare) {
+  if (*items == inline_items && borrow(parser) && spare->capacity > *capacity) {
+    memcpy(spare->items, inline_items, count * size);
+    *items = spare->items;
+    *capacity = spare->capacity;
+    *spare = (parser_block_t) { NULL, 0 };
+    return true;
+  }
+
+  const artm_allocator_t* allocator = &parser->calc->allocator;
+  size_t next = *capacity * 2;
+  void* grown = *items == inline_items
+    ? alloc_new(allocator, next * size)
+    : alloc_resize(allocator, *items, next * size);
+  if (grown == NULL)
+    return false;
+
+  if (*items == inline_items)
+    memcpy(grown, inline_items, count * size);
+  *items = grown;
+  *capacity = next;
+  return true;
+}
+
+// While the spare is borrowed the biggest stack is the one that is kept
+static void give_back(parser_t* parser, void* items, const void* inline_items, size_t capacity, parser_block_t* spare) {
+  if (items == inline_items)
+    return;
+
+  const artm_allocator_t* allocator = &parser->calc->allocator;
+  if (parser->borrowed && capacity > spare->capacity) {
+    alloc_free(allocator, spare->items);
+    *spare = (parser_block_t) { items, capacity };
+  } else {
+    alloc_free(allocator, items);
+  }
+}
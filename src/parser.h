@@ -0,0 +1,149 @@
+/* Parser - Iterative math expression parser
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_PARSER_H
+#define ARITHMO_PARSER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "arithmo.h"
+#include "func.h"
+#include "lexer.h"
+#include "program.h"
+#include "result.h"
+#include "token.h"
+
+// Most expressions never need more, so nothing is allocated for them
+#define PARSER_INLINE_SIZE 32
+
+// The token helpers of the parser, the compiler and the calc, which all
+// return the error from the function that uses them
+#define PARSER_CHECK_TOKEN(_parser_) \
+  do { \
+    if (_parser_->token.type == TKN_ERROR) { \
+      return ARTM_ERROR(ARTM_INV_TOKEN, _parser_->token); \
+    } \
+  } while (0)
+
+#define PARSER_ADVANCE(_parser_) \
+  do { \
+    _parser_->token = lexer_next(&_parser_->lexer); \
+    PARSER_CHECK_TOKEN(_parser_); \
+  } while (0)
+
+#define PARSER_CONSUME(_parser_, _type_, _status_) \
+  do { \
+    if (_parser_->token.type == _type_) { \
+      PARSER_ADVANCE(_parser_); \
+    } else { \
+      return ARTM_ERROR(_status_, _parser_->token); \
+    } \
+  } while (0)
+
+typedef struct parser parser_t;
+typedef struct parser_level parser_level_t;
+typedef struct parser_frame parser_frame_t;
+typedef struct parser_block parser_block_t;
+typedef struct parser_spare parser_spare_t;
+
+typedef enum {
+  FRAME_PAREN,
+  FRAME_CALL,
+  FRAME_NEG
+} parser_frame_type_t;
+
+// The operators of one (parenthesized or argument) expression that are
+// waiting for their right operand; the token type is TKN_END when none is
+struct parser_level {
+  double sum;
+  double product;
+  token_t add;
+  token_t mul;
+};
+
+// A parenthesis, call or unary minus that is not closed yet, with the
+// level it interrupted
+struct parser_frame {
+  parser_frame_type_t type;
+  token_t token;
+  const func_t* func;
+  size_t args;
+  parser_level_t level;
+};
+
+struct parser_block {
+  void* items;
+  size_t capacity;
+};
+
+// The grown stacks of the last deep expression, which a calc lends to the
+// next parse that outgrows its inline items (one parse at a time)
+struct parser_spare {
+  atomic_flag busy;
+  parser_block_t frames;
+  parser_block_t args;
+};
+
+// Without a program the expression is evaluated while it is parsed,
+// otherwise it is compiled into the program
+struct parser {
+  artm_calc_t* calc;
+  program_t* program;
+  bool resolve;
+  bool borrowed;
+  lexer_t lexer;
+  token_t token;
+  size_t max_depth;
+  struct {
+    parser_frame_t* items;
+    size_t count;
+    size_t capacity;
+    parser_frame_t inline_items[PARSER_INLINE_SIZE];
+  } frames;
+  struct {
+    double* items;
+    size_t count;
+    size_t capacity;
+    double inline_items[PARSER_INLINE_SIZE];
+  } args;
+};
+
+// The most values a program compiled under max_depth keeps on its stack:
+// every level holds at most a pending sum, a pending product and the
+// arguments of a call before the next level starts
+static inline size_t parser_max_height(size_t max_depth) {
+  return (max_depth + 1) * (FUNC_MAX_ARITY + 2);
+}
+
+static inline bool parser_check(const parser_t* parser, token_type_t type) {
+  return parser->token.type == type;
+}
+
+extern void parser_init(parser_t* parser, artm_calc_t* calc, const char* expression, size_t size);
+extern void parser_free(parser_t* parser);
+
+extern void parser_spare_init(parser_spare_t* spare);
+extern void parser_spare_free(parser_spare_t* spare, const artm_allocator_t* allocator);
+
+extern artm_result_t parser_expr(parser_t* parser);
+extern artm_result_t parser_emit_named(parser_t* parser, opcode_t op, token_t id);
+
+#endif // ARITHMO_PARSER_H
@@ -0,0 +1,163 @@
+/* Pool - A work-stealing thread pool
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdatomic.h>
+
+#include "alloc.h"
+#include "pool.h"
+
+#define POOL_CACHE_LINE 64
+#define POOL_MAX_CHUNK 256
+
+// Chunks per worker: small enough chunks so that cheap and expensive
+// items balance out, big enough so that claiming them stays cheap
+#define POOL_CHUNKS_PER_WORKER 16
+
+// Every worker owns a contiguous range of items. It claims chunks from the
+// front of its own range and, once that is exhausted, steals chunks from the
+// front of the other workers' ranges.
+struct pool_worker {
+  _Alignas(POOL_CACHE_LINE) atomic_size_t next;
+  size_t end;
+  size_t index;
+  pool_t* pool;
+  pthread_t thread;
+};
+
+static void* work(void* payload);
+static void run_ranges(pool_t* pool, size_t index);
+
+extern bool pool_init(pool_t* pool, size_t size, const artm_allocator_t* allocator) {
+  pool->allocator = allocator;
+  pool->size = size > 0 ? size : 1;
+  pool->generation = pool->running = 0;
+  pool->stopping = false;
+
+  pool->workers = (pool_worker_t*) alloc_aligned(allocator, POOL_CACHE_LINE, pool->size * sizeof(pool_worker_t));
+  if (pool->workers == NULL)
+    return false;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  // The calling thread acts as worker 0
+  for (size_t i = 0; i < pool->size; ++i) {
+    pool_worker_t* worker = &pool->workers[i];
+    atomic_init(&worker->next, 0);
+    worker->end = 0;
+    worker->index = i;
+    worker->pool = pool;
+
+    if (i > 0 && pthread_create(&worker->thread, NULL, work, worker) != 0) {
+      pool->size = i;
+      pool_free(pool);
+      return false;
+    }
+  }
+  return true;
+}
+
+extern void pool_free(pool_t* pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 1; i < pool->size; ++i)
+    pthread_join(pool->workers[i].thread, NULL);
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->start);
+  pthread_mutex_destroy(&pool->lock);
+  alloc_aligned_free(pool->allocator, pool->workers);
+}
+
+extern void pool_run(pool_t* pool, size_t count, pool_task_t task, void* payload) {
+  if (count == 0)
+    return;
+
+  size_t chunk = count / (pool->size * POOL_CHUNKS_PER_WORKER);
+  chunk = chunk < 1 ? 1 : chunk > POOL_MAX_CHUNK ? POOL_MAX_CHUNK : chunk;
+
+  size_t share = count / pool->size;
+  size_t rest = count % pool->size;
+  for (size_t i = 0, begin = 0; i < pool->size; ++i) {
+    size_t end = begin + share + (i < rest ? 1 : 0);
+    atomic_store_explicit(&pool->workers[i].next, begin, memory_order_relaxed);
+    pool->workers[i].end = end;
+    begin = end;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->job.task = task;
+  pool->job.payload = payload;
+  pool->job.chunk = chunk;
+  pool->running = pool->size - 1;
+  ++pool->generation;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_ranges(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->running > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void* work(void* payload) {
+  pool_worker_t* worker = (pool_worker_t*) payload;
+  pool_t* pool = worker->pool;
+  size_t generation = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->stopping && pool->generation == generation)
+      pthread_cond_wait(&pool->start, &pool->lock);
+    if (pool->stopping)
+      break;
+
+    generation = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_ranges(pool, worker->index);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0)
+      pthread_cond_signal(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+static void run_ranges(pool_t* pool, size_t index) {
+  // Start with the own range, then walk the other ones as a thief
+  for (size_t i = 0; i < pool->size; ++i) {
+    pool_worker_t* victim = &pool->workers[(index + i) % pool->size];
+    for (;;) {
+      size_t begin = atomic_fetch_add_explicit(&victim->next, pool->job.chunk, memory_order_relaxed);
+      if (begin >= victim->end)
+        break;
+
+      size_t end = begin + pool->job.chunk;
+      pool->job.task(pool->job.payload, begin, end < victim->end ? end : victim->end);
+    }
+  }
+}
@@ -0,0 +1,55 @@
+/* Pool - A work-stealing thread pool
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_POOL_H
+#define ARITHMO_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "arithmo.h"
+
+typedef struct pool pool_t;
+typedef struct pool_worker pool_worker_t;
+typedef void (*pool_task_t)(void* payload, size_t begin, size_t end);
+
+struct pool {
+  const artm_allocator_t* allocator;
+  size_t size;
+  pool_worker_t* workers;
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  size_t generation;
+  size_t running;
+  bool stopping;
+  struct {
+    pool_task_t task;
+    void* payload;
+    size_t chunk;
+  } job;
+};
+
+extern bool pool_init(pool_t* pool, size_t size, const artm_allocator_t* allocator);
+extern void pool_free(pool_t* pool);
+
+extern void pool_run(pool_t* pool, size_t count, pool_task_t task, void* payload);
+
+#endif // ARITHMO_POOL_H
@@ -0,0 +1,206 @@
+/* Program - Compiled math expression bytecode
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "alloc.h"
+#include "calc.h"
+#include "graph.h"
+#include "program.h"
+#include "result.h"
+
+#define PROGRAM_MIN_CAPACITY 8
+#define PROGRAM_DUMP_COLUMN 14
+
+// Deeper programs get their stack from the allocator instead
+#define PROGRAM_STACK_SIZE 256
+
+static artm_result_t run(const program_t* program, double* stack);
+static bool grow(program_t* program);
+static void track(program_t* program, const instr_t* instr);
+
+static const char* const names[] = {
+  [OP_CONST] = "const",
+  [OP_LOAD] = "load",
+  [OP_STORE] = "store",
+  [OP_NEG] = "neg",
+  [OP_ADD] = "add",
+  [OP_SUB] = "sub",
+  [OP_MUL] = "mul",
+  [OP_DIV] = "div",
+  [OP_CALL] = "call"
+};
+
+extern void program_init(program_t* program, const artm_allocator_t* allocator) {
+  program->code = NULL;
+  program->tokens = NULL;
+  program->size = program->capacity = 0;
+  program->height = program->depth = 0;
+  program->allocator = allocator;
+}
+
+// The program stays usable (and empty) afterwards
+extern void program_free(program_t* program) {
+  alloc_free(program->allocator, program->code);
+  alloc_free(program->allocator, program->tokens);
+  program_init(program, program->allocator);
+}
+
+extern bool program_emit(program_t* program, instr_t instr, token_t token) {
+  if (program->size == program->capacity && !grow(program))
+    return false;
+
+  program->code[program->size] = instr;
+  program->tokens[program->size] = token;
+  ++program->size;
+  track(program, &instr);
+  return true;
+}
+
+extern void program_measure(program_t* program) {
+  program->height = program->depth = 0;
+  for (size_t i = 0; i < program->size; ++i)
+    track(program, &program->code[i]);
+}
+
+extern artm_result_t program_run(const program_t* program) {
+  if (program->depth < PROGRAM_STACK_SIZE) {
+    double stack[PROGRAM_STACK_SIZE];
+    return run(program, stack);
+  }
+
+  double* stack = (double*) alloc_new(program->allocator, (program->depth + 1) * sizeof(double));
+  if (stack == NULL) {
+    return ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+  }
+
+  artm_result_t result = run(program, stack);
+  alloc_free(program->allocator, stack);
+  return result;
+}
+
+extern void program_dump(const program_t* program, FILE* stream) {
+  for (size_t i = 0; i < program->size; ++i) {
+    const instr_t* instr = &program->code[i];
+    int width = fprintf(stream, "%4zu  %s", i, names[instr->op]);
+    switch (instr->op) {
+      case OP_CONST:
+        fprintf(stream, "%*s%.17g", PROGRAM_DUMP_COLUMN - width, "", instr->as.value);
+        break;
+      case OP_LOAD:
+      case OP_STORE:
+        fprintf(stream, "%*s%s", PROGRAM_DUMP_COLUMN - width, "", instr->as.var->name);
+        break;
+      case OP_CALL:
+        fprintf(stream, "%*s%s", PROGRAM_DUMP_COLUMN - width, "", instr->as.func->name);
+        break;
+      default: break;
+    }
+    fputc('\n', stream);
+  }
+}
+
+static artm_result_t run(const program_t* program, double* stack) {
+  size_t top = 0;
+
+  for (size_t i = 0; i < program->size; ++i) {
+    const instr_t* instr = &program->code[i];
+    switch (instr->op) {
+      case OP_CONST:
+        stack[top++] = instr->as.value;
+        break;
+      case OP_LOAD:
+        if (!var_defined(instr->as.var))
+          return ARTM_ERROR(ARTM_UNDEF_VAR, program->tokens[i]);
+        if (instr->as.var->dirty)
+          graph_update(instr->as.var);
+        stack[top++] = var_value(instr->as.var);
+        break;
+      case OP_STORE:
+        if (instr->as.var->constant)
+          return ARTM_ERROR(ARTM_CONST_VAR, program->tokens[i]);
+        artm_var_set(instr->as.var, stack[top - 1]);
+        break;
+      case OP_NEG:
+        stack[top - 1] = -stack[top - 1];
+        break;
+      case OP_ADD:
+        --top;
+        stack[top - 1] = stack[top - 1] + stack[top];
+        break;
+      case OP_SUB:
+        --top;
+        stack[top - 1] = stack[top - 1] - stack[top];
+        break;
+      case OP_MUL:
+        --top;
+        stack[top - 1] = stack[top - 1] * stack[top];
+        break;
+      case OP_DIV:
+        --top;
+        stack[top - 1] = stack[top - 1] / stack[top];
+        break;
+      case OP_CALL:
+        top -= instr->as.func->arity;
+        stack[top] = func_call(instr->as.func, &stack[top]);
+        ++top;
+        break;
+    }
+  }
+
+  return ARTM_VALUE(top > 0 ? stack[top - 1] : 0);
+}
+
+static void track(program_t* program, const instr_t* instr) {
+  switch (instr->op) {
+    case OP_CONST:
+    case OP_LOAD:
+      if (++program->height > program->depth)
+        program->depth = program->height;
+      break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+      --program->height;
+      break;
+    case OP_CALL:
+      // The arguments are replaced by the result
+      program->height = program->height + 1 - instr->as.func->arity;
+      if (program->height > program->depth)
+        program->depth = program->height;
+      break;
+    default: break;
+  }
+}
+
+static bool grow(program_t* program) {
+  size_t capacity = program->capacity < PROGRAM_MIN_CAPACITY
+    ? PROGRAM_MIN_CAPACITY
+    : program->capacity * 2;
+
+  instr_t* code = (instr_t*) alloc_resize(program->allocator, program->code, capacity * sizeof(instr_t));
+  if (code == NULL) return false;
+  program->code = code;
+
+  token_t* tokens = (token_t*) alloc_resize(program->allocator, program->tokens, capacity * sizeof(token_t));
+  if (tokens == NULL) return false;
+  program->tokens = tokens;
+
+  program->capacity = capacity;
+  return true;
+}
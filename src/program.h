@@ -0,0 +1,73 @@
+/* Program - Compiled math expression bytecode
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_PROGRAM_H
+#define ARITHMO_PROGRAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "arithmo.h"
+#include "func.h"
+#include "token.h"
+
+typedef struct program program_t;
+typedef struct instr instr_t;
+
+typedef enum {
+  OP_CONST,
+  OP_LOAD,
+  OP_STORE,
+  OP_NEG,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_CALL
+} opcode_t;
+
+struct instr {
+  opcode_t op;
+  union {
+    double value;
+    artm_var_t var;
+    const func_t* func;
+  } as;
+};
+
+struct program {
+  instr_t* code;
+  token_t* tokens;
+  size_t size;
+  size_t capacity;
+  size_t height;
+  size_t depth;
+  const artm_allocator_t* allocator;
+};
+
+extern void program_init(program_t* program, const artm_allocator_t* allocator);
+extern void program_free(program_t* program);
+
+extern bool program_emit(program_t* program, instr_t instr, token_t token);
+extern void program_measure(program_t* program);
+extern artm_result_t program_run(const program_t* program);
+extern void program_dump(const program_t* program, FILE* stream);
+
+#endif // ARITHMO_PROGRAM_H
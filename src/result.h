@@ -0,0 +1,39 @@
+/* Result - Evaluation result helpers
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_RESULT_H
+#define ARITHMO_RESULT_H
+
+#include "arithmo.h"
+#include "token.h"
+
+#define ARTM_VALUE(_value_) \
+  ((artm_result_t) { ARTM_SUCCESS, { .value = (_value_) } })
+
+#define ARTM_ERROR(_status_, _token_) \
+  ((artm_result_t) { (_status_), { .token = { (_token_).size, (_token_).target } } })
+
+#define ARTM_CHECK_RESULT(_var_name_) \
+  do { \
+    if (_var_name_.status != ARTM_SUCCESS) { \
+      return _var_name_; \
+    } \
+  } while (0)
+
+#endif // ARITHMO_RESULT_H
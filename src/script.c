@@ -0,0 +1,207 @@
+/* Script - Statement blocks evaluated or compiled in one pass
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "arithmo.h"
+#include "alloc.h"
+#include "calc.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "program.h"
+#include "result.h"
+
+static bool add_statement(artm_script_t* script, size_t* capacity);
+static void skip_empty(parser_t* parser);
+static artm_result_t end_statement(const parser_t* parser, artm_result_t result);
+
+static inline void set_error(artm_result_t* error, artm_result_t result) {
+  if (error != NULL) {
+    *error = result;
+  }
+}
+
+// The results past the capacity are counted but not stored
+static inline void add_result(artm_result_t* results, size_t capacity, size_t* done, artm_result_t result) {
+  if (*done < capacity)
+    results[*done] = result;
+  ++*done;
+}
+
+extern artm_result_t artm_calc_eval_script(artm_calc_t* calc, const char* script, artm_result_t* results, size_t* count) {
+  if (calc == NULL) {
+    return ARTM_ERROR(ARTM_NULL_CALC, (token_t) { 0 });
+  }
+
+  if (script == NULL) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+
+  STATS(uint64_t start = stats_start(&calc->stats);)
+  size_t capacity = results != NULL && count != NULL ? *count : 0;
+  size_t done = 0;
+  artm_result_t result = ARTM_VALUE(0);
+
+  parser_t parser;
+  parser_init(&parser, calc, script, strlen(script));
+  parser.lexer.separators = true;
+  parser.token = lexer_next(&parser.lexer);
+  for (skip_empty(&parser); parser.token.type != TKN_END; skip_empty(&parser)) {
+    result = end_statement(&parser, calc_statement(&parser, false));
+    add_result(results, capacity, &done, result);
+    if (result.status != ARTM_SUCCESS)
+      break;
+  }
+  STATS(stats_add(&calc->stats.tokens, parser.lexer.tokens);)
+  parser_free(&parser);
+
+  if (count != NULL)
+    *count = done;
+  STATS(stats_eval(&calc->stats, result.status, start);)
+  return result;
+}
+
+// Every statement gets its own program, so the results of all of them
+// can be reported; the text is lexed only once for the whole script
+extern artm_script_t* artm_calc_compile_script(artm_calc_t* calc, const char* script, artm_result_t* error) {
+  if (calc == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_NULL_CALC, (token_t) { 0 }));
+    return NULL;
+  }
+
+  if (script == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  artm_script_t* compiled = (artm_script_t*) alloc_zeroed(&calc->allocator, 1, sizeof(artm_script_t));
+  if (compiled == NULL) {
+    set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  size_t size = strlen(script);
+  compiled->calc = calc;
+  compiled->source = alloc_strndup(&calc->allocator, script, size);
+  if (compiled->source == NULL) {
+    artm_script_free(compiled);
+    set_error(error, ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 }));
+    return NULL;
+  }
+
+  size_t capacity = 0;
+  artm_result_t result = ARTM_VALUE(0);
+
+  parser_t comp;
+  parser_init(&comp, calc, compiled->source, size);
+  comp.resolve = true;
+  comp.lexer.separators = true;
+  comp.token = lexer_next(&comp.lexer);
+  for (skip_empty(&comp); comp.token.type != TKN_END; skip_empty(&comp)) {
+    if (!add_statement(compiled, &capacity)) {
+      result = ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+      break;
+    }
+
+    program_t* program = &compiled->statements[compiled->count - 1];
+    comp.program = program;
+    result = end_statement(&comp, compile_statement(&comp));
+    if (result.status == ARTM_SUCCESS && !optimize(program, ARTM_OPT_DEFAULT))
+      result = ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+    if (result.status != ARTM_SUCCESS)
+      break;
+  }
+  STATS(stats_add(&calc->stats.tokens, comp.lexer.tokens);)
+  parser_free(&comp);
+
+  if (result.status != ARTM_SUCCESS) {
+    // Point the error token back into the caller's text
+    if (result.as.token.target != NULL)
+      result.as.token.target = script + (result.as.token.target - compiled->source);
+    set_error(error, result);
+    artm_script_free(compiled);
+    return NULL;
+  }
+
+  set_error(error, result);
+  return compiled;
+}
+
+extern artm_result_t artm_script_eval(const artm_script_t* script, artm_result_t* results, size_t* count) {
+  if (script == NULL) {
+    return ARTM_ERROR(ARTM_NULL_EXPR, (token_t) { 0 });
+  }
+
+  STATS(uint64_t start = stats_start(&script->calc->stats);)
+  size_t capacity = results != NULL && count != NULL ? *count : 0;
+  size_t done = 0;
+  artm_result_t result = ARTM_VALUE(0);
+  for (size_t i = 0; i < script->count; ++i) {
+    result = program_run(&script->statements[i]);
+    add_result(results, capacity, &done, result);
+    if (result.status != ARTM_SUCCESS)
+      break;
+  }
+
+  if (count != NULL)
+    *count = done;
+  STATS(stats_eval(&script->calc->stats, result.status, start);)
+  return result;
+}
+
+extern void artm_script_free(artm_script_t* script) {
+  if (script != NULL) {
+    const artm_allocator_t* allocator = &script->calc->allocator;
+    for (size_t i = 0; i < script->count; ++i)
+      program_free(&script->statements[i]);
+    alloc_free(allocator, script->statements);
+    alloc_free(allocator, script->source);
+    alloc_free(allocator, script);
+  }
+}
+
+static bool add_statement(artm_script_t* script, size_t* capacity) {
+  const artm_allocator_t* allocator = &script->calc->allocator;
+  if (script->count == *capacity) {
+    size_t next = *capacity == 0 ? 8 : *capacity * 2;
+    program_t* statements = (program_t*) alloc_resize(allocator, script->statements, next * sizeof(program_t));
+    if (statements == NULL)
+      return false;
+    script->statements = statements;
+    *capacity = next;
+  }
+
+  program_init(&script->statements[script->count++], allocator);
+  return true;
+}
+
+static void skip_empty(parser_t* parser) {
+  while (parser->token.type == TKN_SEMI)
+    parser->token = lexer_next(&parser->lexer);
+}
+
+// A statement has to stop at a separator (or at the end of the script),
+// so "1 2" is an error instead of two statements
+static artm_result_t end_statement(const parser_t* parser, artm_result_t result) {
+  if (result.status == ARTM_SUCCESS && parser->token.type != TKN_SEMI && parser->token.type != TKN_END)
+    return ARTM_ERROR(ARTM_INV_TOKEN, parser->token);
+  return result;
+}
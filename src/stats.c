@@ -0,0 +1,101 @@
+/* Stats - Optional runtime counters of a calc
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+
+#ifdef ARTM_STATS
+
+#include <string.h>
+#include <time.h>
+
+static inline uint64_t now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t) time.tv_sec * 1000000000 + (uint64_t) time.tv_nsec;
+}
+
+// Bucket i counts the evaluations that took [2^i, 2^(i+1)) nanoseconds
+static inline size_t bucket(uint64_t elapsed) {
+  size_t index = elapsed > 0 ? (size_t) (63 - __builtin_clzll(elapsed)) : 0;
+  return index < ARTM_STATS_BUCKETS ? index : ARTM_STATS_BUCKETS - 1;
+}
+
+extern void stats_init(stats_t* stats, bool timing) {
+  atomic_init(&stats->evaluations, 0);
+  atomic_init(&stats->tokens, 0);
+  atomic_init(&stats->lookups, 0);
+  atomic_init(&stats->probes, 0);
+  atomic_init(&stats->max_probes, 0);
+  atomic_init(&stats->allocations, 0);
+  atomic_init(&stats->allocated_bytes, 0);
+  for (size_t i = 0; i < ARTM_STATUS_COUNT; ++i)
+    atomic_init(&stats->errors[i], 0);
+  for (size_t i = 0; i < ARTM_STATS_BUCKETS; ++i)
+    atomic_init(&stats->latency[i], 0);
+
+  stats->timing = timing;
+  stats->hook = (artm_stats_hook_t) { 0 };
+}
+
+extern void stats_snapshot(const stats_t* stats, artm_stats_t* snapshot) {
+  memset(snapshot, 0, sizeof(artm_stats_t));
+  snapshot->enabled = true;
+  snapshot->evaluations = atomic_load_explicit(&stats->evaluations, memory_order_relaxed);
+  snapshot->tokens = atomic_load_explicit(&stats->tokens, memory_order_relaxed);
+  snapshot->lookups = atomic_load_explicit(&stats->lookups, memory_order_relaxed);
+  snapshot->probes = atomic_load_explicit(&stats->probes, memory_order_relaxed);
+  snapshot->max_probes = atomic_load_explicit(&stats->max_probes, memory_order_relaxed);
+  snapshot->allocations = atomic_load_explicit(&stats->allocations, memory_order_relaxed);
+  snapshot->allocated_bytes = atomic_load_explicit(&stats->allocated_bytes, memory_order_relaxed);
+  for (size_t i = 0; i < ARTM_STATUS_COUNT; ++i)
+    snapshot->errors[i] = atomic_load_explicit(&stats->errors[i], memory_order_relaxed);
+  for (size_t i = 0; i < ARTM_STATS_BUCKETS; ++i)
+    snapshot->latency[i] = atomic_load_explicit(&stats->latency[i], memory_order_relaxed);
+}
+
+extern uint64_t stats_start(const stats_t* stats) {
+  return stats->timing ? now() : 0;
+}
+
+extern void stats_eval(stats_t* stats, artm_status_t status, uint64_t start) {
+  uint64_t count = atomic_fetch_add_explicit(&stats->evaluations, 1, memory_order_relaxed) + 1;
+  if (status != ARTM_SUCCESS && (size_t) status < ARTM_STATUS_COUNT)
+    stats_add(&stats->errors[status], 1);
+  if (stats->timing)
+    stats_add(&stats->latency[bucket(now() - start)], 1);
+
+  // The hook runs on whichever thread completes the interval
+  if (stats->hook.target != NULL && stats->hook.interval > 0 && count % stats->hook.interval == 0) {
+    artm_stats_t snapshot;
+    stats_snapshot(stats, &snapshot);
+    stats->hook.target(&snapshot, stats->hook.payload);
+  }
+}
+
+extern void stats_probes(stats_t* stats, size_t probes) {
+  stats_add(&stats->lookups, 1);
+  stats_add(&stats->probes, probes);
+
+  uint_fast64_t longest = atomic_load_explicit(&stats->max_probes, memory_order_relaxed);
+  while (probes > longest && !atomic_compare_exchange_weak_explicit(
+    &stats->max_probes, &longest, probes, memory_order_relaxed, memory_order_relaxed
+  ));
+}
+
+#endif
@@ -0,0 +1,76 @@
+/* Stats - Optional runtime counters of a calc
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_STATS_H
+#define ARITHMO_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "arithmo.h"
+
+// Statements that only exist in builds with ARTM_STATS, so that the
+// counters cost nothing when they are compiled out
+#ifdef ARTM_STATS
+#define STATS(...) __VA_ARGS__
+#else
+#define STATS(...)
+#endif
+
+#ifdef ARTM_STATS
+
+typedef struct stats stats_t;
+
+struct stats {
+  atomic_uint_fast64_t evaluations;
+  atomic_uint_fast64_t tokens;
+  atomic_uint_fast64_t lookups;
+  atomic_uint_fast64_t probes;
+  atomic_uint_fast64_t max_probes;
+  atomic_uint_fast64_t allocations;
+  atomic_uint_fast64_t allocated_bytes;
+  atomic_uint_fast64_t errors[ARTM_STATUS_COUNT];
+  atomic_uint_fast64_t latency[ARTM_STATS_BUCKETS];
+  bool timing;
+  artm_stats_hook_t hook;
+};
+
+extern void stats_init(stats_t* stats, bool timing);
+extern void stats_snapshot(const stats_t* stats, artm_stats_t* snapshot);
+
+extern uint64_t stats_start(const stats_t* stats);
+extern void stats_eval(stats_t* stats, artm_status_t status, uint64_t start);
+extern void stats_probes(stats_t* stats, size_t probes);
+
+static inline void stats_add(atomic_uint_fast64_t* counter, uint64_t count) {
+  atomic_fetch_add_explicit(counter, count, memory_order_relaxed);
+}
+
+static inline void stats_alloc(stats_t* stats, size_t bytes) {
+  if (stats != NULL) {
+    stats_add(&stats->allocations, 1);
+    stats_add(&stats->allocated_bytes, bytes);
+  }
+}
+
+#endif
+
+#endif // ARITHMO_STATS_H
@@ -0,0 +1,159 @@
+/* Store - Variables table with lock-free readers
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "calc.h"
+#include "store.h"
+#include "table.h"
+
+#define STORE_EMPTY 0
+#define STORE_MIN_SIZE 8
+
+// The store grows when more than 3/4 of the slots are in use
+#define STORE_MAX_LOAD(_size_) ((_size_) / 4 * 3)
+
+static size_t size_for(size_t count);
+static bool grow(store_t* store, size_t size);
+static void insert(store_block_t* block, artm_var_t var, size_t size, uint64_t hash);
+
+static inline store_block_t* current(const store_t* store, memory_order order) {
+  return atomic_load_explicit(&store->block, order);
+}
+
+extern void store_init(store_t* store, size_t count, const artm_allocator_t* allocator) {
+  atomic_init(&store->block, NULL);
+  store->count = 0;
+  store->allocator = allocator;
+  STATS(store->stats = NULL;)
+  store_reserve(store, count);
+}
+
+extern void store_free(store_t* store) {
+  store_block_t* block = current(store, memory_order_relaxed);
+  while (block != NULL) {
+    store_block_t* retired = block->retired;
+    alloc_free(store->allocator, block);
+    block = retired;
+  }
+  atomic_init(&store->block, NULL);
+}
+
+extern bool store_reserve(store_t* store, size_t count) {
+  const store_block_t* block = current(store, memory_order_relaxed);
+  size_t size = size_for(count);
+  return (block != NULL && size <= block->size) || grow(store, size);
+}
+
+// Only the writer walks the store, so nothing is inserted meanwhile
+extern void store_each(const store_t* store, store_each_t callback, void* payload) {
+  const store_block_t* block = current(store, memory_order_relaxed);
+  for (size_t i = 0; block != NULL && i < block->size; ++i) {
+    artm_var_t var = atomic_load_explicit(&block->slots[i].var, memory_order_relaxed);
+    if (var != NULL)
+      callback(var, payload);
+  }
+}
+
+// The acquire loads pair with the release stores of insert and grow, so a
+// variable is only seen once it is fully initialized. The sizes are
+// compared first, so no name is read past its end
+extern artm_var_t store_get(const store_t* store, const char* name, size_t size) {
+  const store_block_t* block = current(store, memory_order_acquire);
+  if (block == NULL)
+    return NULL;
+
+  uint64_t code = table_hash(name, size);
+  size_t mask = block->size - 1;
+  size_t probes = 0;
+  artm_var_t result = NULL;
+  for (size_t index = code & mask;; index = (index + 1) & mask) {
+    const store_slot_t* slot = &block->slots[index];
+    ++probes;
+    uint64_t hash = atomic_load_explicit(&slot->hash, memory_order_acquire);
+    if (hash == STORE_EMPTY)
+      break;
+
+    artm_var_t var = atomic_load_explicit(&slot->var, memory_order_relaxed);
+    if (hash == code && slot->size == size && memcmp(var->name, name, size) == 0) {
+      result = var;
+      break;
+    }
+  }
+
+  STATS(if (store->stats != NULL) stats_probes(store->stats, probes);)
+  return result;
+}
+
+// The name is the one of the variable, which never moves
+extern bool store_put(store_t* store, artm_var_t var, size_t size) {
+  store_block_t* block = current(store, memory_order_relaxed);
+  if (block == NULL || store->count + 1 > STORE_MAX_LOAD(block->size)) {
+    if (!grow(store, size_for(store->count + 1)))
+      return false;
+    block = current(store, memory_order_relaxed);
+  }
+
+  insert(block, var, size, table_hash(var->name, size));
+  ++store->count;
+  return true;
+}
+
+// Readers that still probe the old block find everything that was
+// inserted before they started
+static bool grow(store_t* store, size_t size) {
+  store_block_t* block = (store_block_t*) alloc_zeroed(
+    store->allocator, 1, sizeof(store_block_t) + size * sizeof(store_slot_t)
+  );
+  if (block == NULL)
+    return false;
+  STATS(if (store->stats != NULL) stats_alloc(store->stats, sizeof(store_block_t) + size * sizeof(store_slot_t));)
+
+  store_block_t* old = current(store, memory_order_relaxed);
+  block->size = size;
+  block->retired = old;
+  for (size_t i = 0; old != NULL && i < old->size; ++i) {
+    const store_slot_t* slot = &old->slots[i];
+    artm_var_t var = atomic_load_explicit(&slot->var, memory_order_relaxed);
+    if (var != NULL)
+      insert(block, var, slot->size, atomic_load_explicit(&slot->hash, memory_order_relaxed));
+  }
+
+  atomic_store_explicit(&store->block, block, memory_order_release);
+  return true;
+}
+
+static void insert(store_block_t* block, artm_var_t var, size_t size, uint64_t hash) {
+  size_t mask = block->size - 1;
+  size_t index = hash & mask;
+  while (atomic_load_explicit(&block->slots[index].hash, memory_order_relaxed) != STORE_EMPTY)
+    index = (index + 1) & mask;
+
+  atomic_store_explicit(&block->slots[index].var, var, memory_order_relaxed);
+  block->slots[index].size = size;
+  atomic_store_explicit(&block->slots[index].hash, hash, memory_order_release);
+}
+
+static size_t size_for(size_t count) {
+  size_t size = STORE_MIN_SIZE;
+  while (STORE_MAX_LOAD(size) < count)
+    size *= 2;
+  return size;
+}
@@ -0,0 +1,70 @@
+/* Store - Variables table with lock-free readers
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_STORE_H
+#define ARITHMO_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "arithmo.h"
+#include "stats.h"
+
+typedef struct store store_t;
+typedef struct store_slot store_slot_t;
+typedef struct store_block store_block_t;
+typedef void (*store_each_t)(artm_var_t var, void* payload);
+
+// A slot is published by its hash, which is stored after the variable and
+// the size of its name
+struct store_slot {
+  _Atomic uint64_t hash;
+  _Atomic(artm_var_t) var;
+  size_t size;
+};
+
+struct store_block {
+  size_t size;
+  store_block_t* retired;
+  store_slot_t slots[];
+};
+
+// The variables are looked up without locks while a single writer at a
+// time inserts them. A full block is replaced by a bigger one, and the
+// replaced blocks stay readable until store_free (they add up to less
+// than the current one)
+struct store {
+  _Atomic(store_block_t*) block;
+  size_t count;
+  const artm_allocator_t* allocator;
+  STATS(stats_t* stats;)
+};
+
+extern void store_init(store_t* store, size_t count, const artm_allocator_t* allocator);
+extern void store_free(store_t* store);
+
+extern bool store_reserve(store_t* store, size_t count);
+extern void store_each(const store_t* store, store_each_t callback, void* payload);
+
+extern artm_var_t store_get(const store_t* store, const char* name, size_t size);
+extern bool store_put(store_t* store, artm_var_t var, size_t size);
+
+#endif // ARITHMO_STORE_H
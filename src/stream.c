@@ -0,0 +1,186 @@
+/* Stream - In-place evaluation of expression files
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "arithmo.h"
+#include "alloc.h"
+#include "calc.h"
+#include "result.h"
+
+#define STREAM_BUFFER_SIZE ((size_t) 1 << 16)
+#define STREAM_WINDOW_SIZE ((size_t) 1 << 26)
+
+static artm_status_t eval_mapped(artm_calc_t* calc, int fd, size_t size, artm_stream_cbk_t cbk);
+static artm_status_t eval_read(artm_calc_t* calc, int fd, artm_stream_cbk_t cbk);
+static size_t eval_pieces(artm_calc_t* calc, const char* data, size_t size, bool last, artm_stream_cbk_t cbk);
+
+static inline bool is_separator(char c) {
+  return c == '\n' || c == ';';
+}
+
+static inline bool is_blank(const char* data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] != ' ' && data[i] != '\t' && data[i] != '\r')
+      return false;
+  }
+  return true;
+}
+
+extern artm_status_t artm_calc_eval_fd(artm_calc_t* calc, int fd, artm_stream_cbk_t cbk) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+  if (cbk.target == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    return ARTM_IO_ERR;
+  }
+
+  if (S_ISREG(info.st_mode) && info.st_size > 0) {
+    return eval_mapped(calc, fd, (size_t) info.st_size, cbk);
+  }
+  return eval_read(calc, fd, cbk);
+}
+
+extern artm_status_t artm_calc_eval_file(artm_calc_t* calc, const char* path, artm_stream_cbk_t cbk) {
+  if (calc == NULL) {
+    return ARTM_NULL_CALC;
+  }
+  if (cbk.target == NULL) {
+    return ARTM_NULL_EXPR;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return ARTM_IO_ERR;
+  }
+
+  artm_status_t status = artm_calc_eval_fd(calc, fd, cbk);
+  close(fd);
+  return status;
+}
+
+// The file is mapped one window at a time so that the memory use stays
+// constant; a window always starts at the page of the first unprocessed byte
+static artm_status_t eval_mapped(artm_calc_t* calc, int fd, size_t size, artm_stream_cbk_t cbk) {
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t window = STREAM_WINDOW_SIZE;
+  size_t offset = 0;
+  size_t skip = 0;
+
+  while (offset + skip < size) {
+    size_t length = size - offset < window ? size - offset : window;
+    char* data = (char*) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, (off_t) offset);
+    if (data == MAP_FAILED) {
+      return offset == 0 ? eval_read(calc, fd, cbk) : ARTM_IO_ERR;
+    }
+
+    madvise(data, length, MADV_SEQUENTIAL);
+    bool last = offset + length == size;
+    size_t used = eval_pieces(calc, data + skip, length - skip, last, cbk);
+    munmap(data, length);
+
+    if (last)
+      break;
+
+    // A single expression is longer than the window
+    if (used == 0) {
+      window *= 2;
+      continue;
+    }
+
+    size_t next = offset + skip + used;
+    offset = next - next % page;
+    skip = next - offset;
+  }
+  return ARTM_SUCCESS;
+}
+
+static artm_status_t eval_read(artm_calc_t* calc, int fd, artm_stream_cbk_t cbk) {
+  size_t capacity = STREAM_BUFFER_SIZE;
+  char* buffer = (char*) alloc_new(&calc->allocator, capacity);
+  if (buffer == NULL) {
+    return ARTM_ALLOC_ERR;
+  }
+
+  artm_status_t status = ARTM_SUCCESS;
+  size_t size = 0;
+  for (;;) {
+    // Only an expression longer than the whole buffer makes it grow
+    if (size == capacity) {
+      char* grown = (char*) alloc_resize(&calc->allocator, buffer, capacity * 2);
+      if (grown == NULL) {
+        status = ARTM_ALLOC_ERR;
+        break;
+      }
+      buffer = grown;
+      capacity *= 2;
+    }
+
+    // A signal that interrupts the read before any data loses nothing
+    ssize_t count = read(fd, buffer + size, capacity - size);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count < 0) {
+      status = ARTM_IO_ERR;
+      break;
+    }
+
+    size += (size_t) count;
+    size_t used = eval_pieces(calc, buffer, size, count == 0, cbk);
+    if (count == 0)
+      break;
+
+    memmove(buffer, buffer + used, size - used);
+    size -= used;
+  }
+
+  alloc_free(&calc->allocator, buffer);
+  return status;
+}
+
+// Returns the number of bytes that were processed: everything up to the last
+// separator, or the whole data for the last chunk of the input
+static size_t eval_pieces(artm_calc_t* calc, const char* data, size_t size, bool last, artm_stream_cbk_t cbk) {
+  size_t start = 0;
+  for (size_t i = 0; i <= size; ++i) {
+    if (i < size ? !is_separator(data[i]) : !last)
+      continue;
+
+    size_t length = i - start;
+    if (!is_blank(data + start, length)) {
+      artm_token_t expression = { length, data + start };
+      artm_result_t result = calc_eval(calc, data + start, length, false);
+      cbk.target(&expression, &result, cbk.payload);
+    }
+    start = i + 1;
+  }
+  return start > size ? size : start;
+}
@@ -1,4 +1,4 @@
-/* Table - A simple hash table implementation
+/* Table - An open addressing hash table implementation
  * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
  *
  * This file is part of Arithmo.
@@ -17,80 +17,234 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <malloc.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
 #include "table.h"
 
-struct table_item {
-  char* key;
-  table_value_t data;
-  table_item_t* next;
-};
+#define TABLE_EMPTY 0
+#define TABLE_TOMBSTONE 1
+#define TABLE_MIN_SIZE 8
+#define TABLE_MIN_KEYS 64
 
-static size_t hash(const char* str, size_t size);
+// The table grows when more than 3/4 of the items are in use
+#define TABLE_MAX_LOAD(_size_) ((_size_) / 4 * 3)
 
-extern void table_init(table_t* table, size_t size) {
-  table->size = size;
-  table->items = (table_item_t**) malloc(size * sizeof(table_item_t*));
-  for (size_t i = 0; i < size; ++i)
-    table->items[i] = NULL;
+static size_t size_for(size_t count);
+static bool rehash(table_t* table, size_t size);
+static bool store_key(table_t* table, const char* key, size_t size, size_t* offset);
+static table_item_t* find(const table_t* table, const char* key, size_t size, uint64_t code, size_t* probes);
+
+static inline bool is_used(const table_item_t* item) {
+  return item->hash != TABLE_EMPTY && item->hash != TABLE_TOMBSTONE;
+}
+
+static inline const char* key_of(const table_t* table, const table_item_t* item) {
+  return table->keys.data + item->key;
+}
+
+extern void table_init(table_t* table, size_t size, const artm_allocator_t* allocator) {
+  table->size = table->count = table->tombstones = 0;
+  table->items = NULL;
+  table->keys.data = NULL;
+  table->keys.size = table->keys.capacity = table->keys.garbage = 0;
+  table->allocator = allocator;
+  STATS(table->stats = NULL;)
+  table_reserve(table, size);
 }
 
 extern void table_free(table_t* table) {
-  for (size_t i = 0; i < table->size; ++i) {
-    table_item_t* current = table->items[i];
-    while (current != NULL) {
-      table_item_t* next = current->next;
-      free(current->key);
-      free(current);
-      current = next;
-    }
-  }
-  free(table->items);
+  alloc_free(table->allocator, table->items);
+  alloc_free(table->allocator, table->keys.data);
 }
 
-extern table_value_t table_get(const table_t* table, const char* key) {
-  size_t index = hash(key, table->size);
-  table_item_t* current = table->items[index];
-  while (current != NULL) {
-    if (strcmp(current->key, key) == 0)
-      return current->data;
-    current = current->next;
-  }
-  return TABLE_PTR_VALUE(NULL);
+extern bool table_reserve(table_t* table, size_t count) {
+  size_t size = size_for(count);
+  return size <= table->size || rehash(table, size);
+}
+
+extern table_value_t table_get(const table_t* table, const char* key, size_t size) {
+  return table_get_hashed(table, key, size, table_hash(key, size));
 }
 
-extern void table_put(table_t* table, const char* key, table_value_t value) {
-  size_t index = hash(key, table->size);
+// For callers that already needed the hash of the key
+extern table_value_t table_get_hashed(const table_t* table, const char* key, size_t size, uint64_t hash) {
+  size_t probes = 0;
+  table_item_t* item = find(table, key, size, hash, &probes);
+  STATS(if (table->stats != NULL) stats_probes(table->stats, probes);)
+  return item != NULL ? item->data : TABLE_PTR_VALUE(NULL);
+}
 
-  table_item_t* node = (table_item_t*) malloc(sizeof(table_item_t));
-  if (node == NULL) return;
+extern bool table_put(table_t* table, const char* key, size_t size, table_value_t value) {
+  size_t probes = 0;
+  uint64_t code = table_hash(key, size);
+  table_item_t* item = find(table, key, size, code, &probes);
+  if (item != NULL) {
+    item->data = value;
+    return true;
+  }
 
-  node->key = strdup(key);
-  if (node->key == NULL) {
-    free(node);
-    return;
+  if (table->count + table->tombstones + 1 > TABLE_MAX_LOAD(table->size)) {
+    if (!rehash(table, size_for(table->count + 1)))
+      return false;
   }
 
-  node->data = value;
-  node->next = table->items[index];
-  table->items[index] = node;
+  size_t offset;
+  if (!store_key(table, key, size, &offset))
+    return false;
+
+  size_t mask = table->size - 1;
+  size_t index = code & mask;
+  while (is_used(&table->items[index]))
+    index = (index + 1) & mask;
+
+  item = &table->items[index];
+  if (item->hash == TABLE_TOMBSTONE)
+    --table->tombstones;
+
+  *item = (table_item_t) { .hash = code, .key = offset, .size = size, .data = value };
+  ++table->count;
+  return true;
+}
+
+extern bool table_remove(table_t* table, const char* key, size_t size) {
+  size_t probes = 0;
+  table_item_t* item = find(table, key, size, table_hash(key, size), &probes);
+  if (item == NULL)
+    return false;
+
+  table->keys.garbage += item->size + 1;
+  item->hash = TABLE_TOMBSTONE;
+  item->data = TABLE_PTR_VALUE(NULL);
+  --table->count;
+  ++table->tombstones;
+  return true;
 }
 
 extern void table_each(const table_t* table, table_each_t callback) {
   for (size_t i = 0; i < table->size; ++i) {
-    table_item_t* current = table->items[i];
-    while (current != NULL) {
-      callback(current->key, &current->data);
-      current = current->next;
+    table_item_t* item = &table->items[i];
+    if (is_used(item))
+      callback(key_of(table, item), &item->data);
+  }
+}
+
+static table_item_t* find(const table_t* table, const char* key, size_t size, uint64_t code, size_t* probes) {
+  if (table->size == 0)
+    return NULL;
+
+  size_t mask = table->size - 1;
+  for (size_t index = code & mask;; index = (index + 1) & mask) {
+    table_item_t* item = &table->items[index];
+    ++*probes;
+    if (item->hash == TABLE_EMPTY)
+      return NULL;
+    if (item->hash == code && item->size == size && memcmp(key_of(table, item), key, size) == 0)
+      return item;
+  }
+}
+
+static bool rehash(table_t* table, size_t size) {
+  table_item_t* items = (table_item_t*) alloc_zeroed(table->allocator, size, sizeof(table_item_t));
+  if (items == NULL)
+    return false;
+
+  table_t result = {
+    .size = size,
+    .items = items,
+    .keys = { .capacity = table->keys.size - table->keys.garbage },
+    .allocator = table->allocator
+  };
+  STATS(result.stats = table->stats;)
+  STATS(if (result.stats != NULL) stats_alloc(result.stats, size * sizeof(table_item_t));)
+
+  if (result.keys.capacity > 0) {
+    result.keys.data = (char*) alloc_new(table->allocator, result.keys.capacity);
+    if (result.keys.data == NULL) {
+      alloc_free(table->allocator, items);
+      return false;
     }
+    STATS(if (result.stats != NULL) stats_alloc(result.stats, result.keys.capacity);)
+  }
+
+  size_t mask = size - 1;
+  for (size_t i = 0; i < table->size; ++i) {
+    table_item_t* item = &table->items[i];
+    if (!is_used(item))
+      continue;
+
+    size_t index = item->hash & mask;
+    while (items[index].hash != TABLE_EMPTY)
+      index = (index + 1) & mask;
+
+    items[index] = *item;
+    items[index].key = result.keys.size;
+    memcpy(result.keys.data + result.keys.size, key_of(table, item), item->size + 1);
+    result.keys.size += item->size + 1;
+    ++result.count;
+  }
+
+  table_free(table);
+  *table = result;
+  return true;
+}
+
+static bool store_key(table_t* table, const char* key, size_t size, size_t* offset) {
+  if (table->keys.size + size + 1 > table->keys.capacity) {
+    size_t capacity = table->keys.capacity < TABLE_MIN_KEYS ? TABLE_MIN_KEYS : table->keys.capacity;
+    while (table->keys.size + size + 1 > capacity)
+      capacity *= 2;
+
+    char* data = (char*) alloc_resize(table->allocator, table->keys.data, capacity);
+    if (data == NULL)
+      return false;
+
+    table->keys.data = data;
+    table->keys.capacity = capacity;
+    STATS(if (table->stats != NULL) stats_alloc(table->stats, capacity);)
   }
+
+  *offset = table->keys.size;
+  memcpy(table->keys.data + table->keys.size, key, size);
+  table->keys.data[table->keys.size + size] = '\0';
+  table->keys.size += size + 1;
+  return true;
+}
+
+static size_t size_for(size_t count) {
+  size_t size = TABLE_MIN_SIZE;
+  while (TABLE_MAX_LOAD(size) < count)
+    size *= 2;
+  return size;
+}
+
+static inline uint64_t rotate(uint64_t value, int shift) {
+  return (value << shift) | (value >> (64 - shift));
 }
 
-static size_t hash(const char* str, size_t size) {
-  size_t result = 0;
-  while (*str != '\0')
-    result += (size_t) *(str++);
-  return result % size;
+// FxHash over 8-byte words followed by the MurmurHash3 finalizer,
+// so that the low bits used for the item index are well mixed (never 0 or 1)
+extern uint64_t table_hash(const char* str, size_t size) {
+  static const uint64_t seed = 0x517cc1b727220a95ULL;
+
+  uint64_t result = seed ^ (uint64_t) size;
+  uint64_t word;
+  for (; size >= sizeof(word); str += sizeof(word), size -= sizeof(word)) {
+    memcpy(&word, str, sizeof(word));
+    result = (rotate(result, 5) ^ word) * seed;
+  }
+
+  if (size > 0) {
+    word = 0;
+    memcpy(&word, str, size);
+    result = (rotate(result, 5) ^ word) * seed;
+  }
+
+  result ^= result >> 33;
+  result *= 0xff51afd7ed558ccdULL;
+  result ^= result >> 33;
+  result *= 0xc4ceb9fe1a85ec53ULL;
+  result ^= result >> 33;
+  return result > TABLE_TOMBSTONE ? result : result + 2;
 }
@@ -1,4 +1,4 @@
-/* Table - A simple hash table implementation
+/* Table - An open addressing hash table implementation
  * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
  *
  * This file is part of Arithmo.
@@ -21,6 +21,11 @@
 #define ARITHMO_TABLE_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arithmo.h"
+#include "stats.h"
 
 #define TABLE_DBL_VALUE(_value_) \
   ((table_value_t) { .type = TAB_VAL_DBL, .as = { .dbl = (_value_) }})
@@ -38,11 +43,6 @@ typedef enum {
   TAB_VAL_PTR
 } table_value_type_t;
 
-struct table {
-  size_t size;
-  struct table_item** items;
-};
-
 struct table_value {
   table_value_type_t type;
   struct {
@@ -51,12 +51,39 @@ struct table_value {
   } as;
 };
 
-extern void table_init(table_t* table, size_t size);
+struct table_item {
+  uint64_t hash;
+  size_t key;
+  size_t size;
+  table_value_t data;
+};
+
+struct table {
+  size_t size;
+  size_t count;
+  size_t tombstones;
+  table_item_t* items;
+  struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    size_t garbage;
+  } keys;
+  const artm_allocator_t* allocator;
+  STATS(stats_t* stats;)
+};
+
+extern void table_init(table_t* table, size_t size, const artm_allocator_t* allocator);
 extern void table_free(table_t* table);
 
+extern bool table_reserve(table_t* table, size_t count);
 extern void table_each(const table_t* table, table_each_t func);
 
-extern table_value_t table_get(const table_t* table, const char* key);
-extern void table_put(table_t* table, const char* key, table_value_t value);
+extern table_value_t table_get(const table_t* table, const char* key, size_t size);
+extern table_value_t table_get_hashed(const table_t* table, const char* key, size_t size, uint64_t hash);
+extern bool table_put(table_t* table, const char* key, size_t size, table_value_t value);
+extern bool table_remove(table_t* table, const char* key, size_t size);
+
+extern uint64_t table_hash(const char* key, size_t size);
 
 #endif // ARITHMO_TABLE_H
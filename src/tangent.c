@@ -0,0 +1,438 @@
+/* Tangent - Forward-mode derivatives of compiled programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "alloc.h"
+#include "calc.h"
+#include "graph.h"
+#include "kernels.h"
+#include "result.h"
+#include "tangent.h"
+
+#define TANGENT_MIN_FORMULAS 8
+#define TANGENT_NONE SIZE_MAX
+
+typedef struct tangent tangent_t;
+typedef struct tangent_visit tangent_visit_t;
+
+// A formula whose inputs are still being visited, and the next one to visit
+struct tangent_visit {
+  artm_var_t var;
+  size_t next;
+};
+
+// Every formula the program reads is differentiated once per call, inputs
+// first, and its value and tangents serve all the loads of it. The walk
+// keeps its own state, since other readers may walk the same formulas at
+// the same time
+struct tangent {
+  const kernels_t* kernels;
+  const artm_var_t* vars;
+  size_t count;
+  const double* seeds;
+  size_t lanes;
+  const artm_allocator_t* allocator;
+  double* buffer;
+  struct {
+    artm_var_t* order;
+    size_t count;
+    size_t known;
+    artm_var_t* index;
+    size_t* slots;
+    size_t size;
+    double* values;
+    double* tangents;
+  } formulas;
+  struct {
+    tangent_visit_t* items;
+    size_t count;
+    size_t capacity;
+  } visits;
+};
+
+static artm_result_t collect(tangent_t* tangent, const program_t* program);
+static bool visit(tangent_t* tangent, artm_var_t root);
+static bool push(tangent_t* tangent, artm_var_t var);
+static bool remember(tangent_t* tangent, artm_var_t var);
+static bool grow(tangent_t* tangent);
+static size_t find(const tangent_t* tangent, artm_var_t var);
+static artm_result_t run(tangent_t* tangent, const program_t* program, double* value, double* out);
+static bool is_formula(const tangent_t* tangent, artm_var_t var);
+static bool is_chosen(const tangent_t* tangent, artm_var_t var);
+static void load(tangent_t* tangent, artm_var_t var, double* out);
+static void call(tangent_t* tangent, const func_t* func, double* args, double* tangents);
+
+static inline void binary(const tangent_t* tangent, kernel_op_t op, kernel_shape_t shape, double* out, const double* a, const double* b) {
+  tangent->kernels->binary[op][shape](out, a, b, tangent->lanes);
+}
+
+static inline size_t hash_of(artm_var_t var) {
+  return (size_t) (((uintptr_t) var >> 4) * 0x9e3779b97f4a7c15ULL);
+}
+
+extern artm_result_t tangent_run(
+  const program_t* program,
+  const artm_var_t* vars, size_t count,
+  const double* seeds, size_t lanes,
+  double* derivatives
+) {
+  double buffer[TANGENT_STACK_SIZE];
+  tangent_t tangent = {
+    .kernels = kernels_select(),
+    .vars = vars,
+    .count = count,
+    .seeds = seeds,
+    .lanes = lanes,
+    .allocator = program->allocator,
+    .buffer = buffer
+  };
+
+  artm_result_t result = collect(&tangent, program);
+  for (size_t i = 0; result.status == ARTM_SUCCESS && i < tangent.formulas.count; ++i) {
+    const program_t* formula = &tangent.formulas.order[i]->formula->program;
+    result = run(&tangent, formula, &tangent.formulas.values[i], tangent.formulas.tangents + i * lanes);
+  }
+
+  double value;
+  if (result.status == ARTM_SUCCESS)
+    result = run(&tangent, program, &value, derivatives);
+
+  const artm_allocator_t* allocator = tangent.allocator;
+  alloc_free(allocator, tangent.formulas.order);
+  alloc_free(allocator, tangent.formulas.index);
+  alloc_free(allocator, tangent.formulas.slots);
+  alloc_free(allocator, tangent.formulas.values);
+  alloc_free(allocator, tangent.formulas.tangents);
+  return result.status == ARTM_SUCCESS ? ARTM_VALUE(value) : result;
+}
+
+// Lists the formulas the program reads (through other formulas too) with
+// their inputs before them; nothing is allocated for a program without any
+static artm_result_t collect(tangent_t* tangent, const program_t* program) {
+  bool ok = true;
+  for (size_t i = 0; ok && i < program->size; ++i) {
+    const instr_t* instr = &program->code[i];
+    if (instr->op == OP_LOAD && is_formula(tangent, instr->as.var) && find(tangent, instr->as.var) == TANGENT_NONE)
+      ok = visit(tangent, instr->as.var);
+  }
+  alloc_free(tangent->allocator, tangent->visits.items);
+
+  size_t count = tangent->formulas.count;
+  if (ok && count > 0) {
+    tangent->formulas.values = (double*) alloc_new(tangent->allocator, count * sizeof(double));
+    tangent->formulas.tangents = (double*) alloc_new(tangent->allocator, count * tangent->lanes * sizeof(double));
+    ok = tangent->formulas.values != NULL && tangent->formulas.tangents != NULL;
+  }
+  return ok ? ARTM_VALUE(0) : ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+}
+
+// A depth-first walk with its own stack, so long chains of formulas don't
+// use the C stack. The formulas have no cycles, so every input that is
+// already known has its slot
+static bool visit(tangent_t* tangent, artm_var_t root) {
+  if (!push(tangent, root))
+    return false;
+
+  while (tangent->visits.count > 0) {
+    tangent_visit_t* current = &tangent->visits.items[tangent->visits.count - 1];
+    const formula_t* formula = current->var->formula;
+    if (current->next == formula->count) {
+      tangent->formulas.slots[find(tangent, current->var)] = tangent->formulas.count;
+      tangent->formulas.order[tangent->formulas.count++] = current->var;
+      --tangent->visits.count;
+      continue;
+    }
+
+    artm_var_t input = formula->inputs[current->next++];
+    if (is_formula(tangent, input) && find(tangent, input) == TANGENT_NONE && !push(tangent, input))
+      return false;
+  }
+  return true;
+}
+
+static bool push(tangent_t* tangent, artm_var_t var) {
+  if (tangent->visits.count == tangent->visits.capacity) {
+    size_t capacity = tangent->visits.capacity < TANGENT_MIN_FORMULAS ? TANGENT_MIN_FORMULAS : tangent->visits.capacity * 2;
+    tangent_visit_t* items = (tangent_visit_t*) alloc_resize(tangent->allocator, tangent->visits.items, capacity * sizeof(tangent_visit_t));
+    if (items == NULL)
+      return false;
+    tangent->visits.items = items;
+    tangent->visits.capacity = capacity;
+  }
+
+  if (!remember(tangent, var))
+    return false;
+  tangent->visits.items[tangent->visits.count++] = (tangent_visit_t) { var, 0 };
+  return true;
+}
+
+// The index is open addressing over the variables, at most half full; a
+// formula gets its slot in the order once all its inputs have one
+static bool remember(tangent_t* tangent, artm_var_t var) {
+  if ((tangent->formulas.known + 1) * 2 > tangent->formulas.size && !grow(tangent))
+    return false;
+
+  size_t mask = tangent->formulas.size - 1;
+  size_t at = hash_of(var) & mask;
+  while (tangent->formulas.index[at] != NULL)
+    at = (at + 1) & mask;
+  tangent->formulas.index[at] = var;
+  tangent->formulas.slots[at] = TANGENT_NONE;
+  ++tangent->formulas.known;
+  return true;
+}
+
+// The order has room for every formula the index can hold
+static bool grow(tangent_t* tangent) {
+  const artm_allocator_t* allocator = tangent->allocator;
+  size_t size = tangent->formulas.size < TANGENT_MIN_FORMULAS * 2 ? TANGENT_MIN_FORMULAS * 2 : tangent->formulas.size * 2;
+  artm_var_t* order = (artm_var_t*) alloc_resize(allocator, tangent->formulas.order, size / 2 * sizeof(artm_var_t));
+  if (order == NULL)
+    return false;
+  tangent->formulas.order = order;
+
+  artm_var_t* index = (artm_var_t*) alloc_zeroed(allocator, size, sizeof(artm_var_t));
+  size_t* slots = (size_t*) alloc_new(allocator, size * sizeof(size_t));
+  if (index == NULL || slots == NULL) {
+    alloc_free(allocator, index);
+    alloc_free(allocator, slots);
+    return false;
+  }
+
+  for (size_t i = 0; i < tangent->formulas.size; ++i) {
+    artm_var_t var = tangent->formulas.index[i];
+    if (var == NULL)
+      continue;
+
+    size_t at = hash_of(var) & (size - 1);
+    while (index[at] != NULL)
+      at = (at + 1) & (size - 1);
+    index[at] = var;
+    slots[at] = tangent->formulas.slots[i];
+  }
+
+  alloc_free(allocator, tangent->formulas.index);
+  alloc_free(allocator, tangent->formulas.slots);
+  tangent->formulas.index = index;
+  tangent->formulas.slots = slots;
+  tangent->formulas.size = size;
+  return true;
+}
+
+// The position of the formula in the index, or TANGENT_NONE
+static size_t find(const tangent_t* tangent, artm_var_t var) {
+  if (tangent->formulas.size == 0)
+    return TANGENT_NONE;
+
+  size_t mask = tangent->formulas.size - 1;
+  for (size_t at = hash_of(var) & mask; tangent->formulas.index[at] != NULL; at = (at + 1) & mask) {
+    if (tangent->formulas.index[at] == var)
+      return at;
+  }
+  return TANGENT_NONE;
+}
+
+// The same instructions as program_run, with lanes tangents next to every
+// value of the stack. The formulas are differentiated before the programs
+// that read them, so a load of one only copies its value and tangents
+static artm_result_t run(tangent_t* tangent, const program_t* program, double* value, double* out) {
+  size_t lanes = tangent->lanes;
+  size_t size = (program->depth + 1) * (lanes + 1);
+  bool owned = size > TANGENT_STACK_SIZE;
+  double* stack = owned ? (double*) alloc_new(tangent->allocator, size * sizeof(double)) : tangent->buffer;
+  if (stack == NULL) {
+    return ARTM_ERROR(ARTM_ALLOC_ERR, (token_t) { 0 });
+  }
+
+  double* tangents = stack + program->depth + 1;
+  size_t top = 0;
+  artm_result_t result = ARTM_VALUE(0);
+  for (size_t i = 0; i < program->size && result.status == ARTM_SUCCESS; ++i) {
+    const instr_t* instr = &program->code[i];
+    double* a;
+    double* b;
+    switch (instr->op) {
+      case OP_CONST:
+        stack[top] = instr->as.value;
+        memset(tangents + top * lanes, 0, lanes * sizeof(double));
+        ++top;
+        break;
+      case OP_LOAD: {
+        artm_var_t var = instr->as.var;
+        if (!var_defined(var)) {
+          result = ARTM_ERROR(ARTM_UNDEF_VAR, program->tokens[i]);
+          break;
+        }
+
+        // A formula is differentiated through its own inputs, unless it is
+        // one of the variables of the derivatives
+        if (is_formula(tangent, var)) {
+          size_t slot = tangent->formulas.slots[find(tangent, var)];
+          stack[top] = tangent->formulas.values[slot];
+          memcpy(tangents + top * lanes, tangent->formulas.tangents + slot * lanes, lanes * sizeof(double));
+        } else {
+          if (var->dirty)
+            graph_update(var);
+          stack[top] = var_value(var);
+          load(tangent, var, tangents + top * lanes);
+        }
+        ++top;
+        break;
+      }
+      case OP_STORE:
+        if (instr->as.var->constant) {
+          result = ARTM_ERROR(ARTM_CONST_VAR, program->tokens[i]);
+          break;
+        }
+        artm_var_set(instr->as.var, stack[top - 1]);
+        break;
+      case OP_NEG:
+        a = tangents + (top - 1) * lanes;
+        stack[top - 1] = -stack[top - 1];
+        tangent->kernels->neg(a, a, lanes);
+        break;
+      case OP_ADD:
+        --top;
+        a = tangents + (top - 1) * lanes;
+        b = tangents + top * lanes;
+        stack[top - 1] += stack[top];
+        binary(tangent, KERNEL_ADD, KERNEL_VV, a, a, b);
+        break;
+      case OP_SUB:
+        --top;
+        a = tangents + (top - 1) * lanes;
+        b = tangents + top * lanes;
+        stack[top - 1] -= stack[top];
+        binary(tangent, KERNEL_SUB, KERNEL_VV, a, a, b);
+        break;
+      case OP_MUL:
+        // (xy)' = x'y + xy'
+        --top;
+        a = tangents + (top - 1) * lanes;
+        b = tangents + top * lanes;
+        binary(tangent, KERNEL_MUL, KERNEL_VS, a, a, &stack[top]);
+        binary(tangent, KERNEL_MUL, KERNEL_VS, b, b, &stack[top - 1]);
+        binary(tangent, KERNEL_ADD, KERNEL_VV, a, a, b);
+        stack[top - 1] *= stack[top];
+        break;
+      case OP_DIV: {
+        // (x/y)' = (x' - (x/y)y') / y
+        --top;
+        a = tangents + (top - 1) * lanes;
+        b = tangents + top * lanes;
+        double quotient = stack[top - 1] / stack[top];
+        binary(tangent, KERNEL_MUL, KERNEL_VS, b, b, &quotient);
+        binary(tangent, KERNEL_SUB, KERNEL_VV, a, a, b);
+        binary(tangent, KERNEL_DIV, KERNEL_VS, a, a, &stack[top]);
+        stack[top - 1] = quotient;
+        break;
+      }
+      case OP_CALL:
+        top -= instr->as.func->arity;
+        call(tangent, instr->as.func, &stack[top], tangents + top * lanes);
+        ++top;
+        break;
+    }
+  }
+
+  if (result.status == ARTM_SUCCESS) {
+    *value = top > 0 ? stack[top - 1] : 0;
+    if (top > 0) {
+      memcpy(out, tangents + (top - 1) * lanes, lanes * sizeof(double));
+    } else {
+      memset(out, 0, lanes * sizeof(double));
+    }
+  }
+
+  if (owned) {
+    alloc_free(tangent->allocator, stack);
+  }
+  return result;
+}
+
+static bool is_formula(const tangent_t* tangent, artm_var_t var) {
+  return var->formula != NULL && !is_chosen(tangent, var);
+}
+
+static bool is_chosen(const tangent_t* tangent, artm_var_t var) {
+  for (size_t v = 0; v < tangent->count; ++v) {
+    if (tangent->vars[v] == var)
+      return true;
+  }
+  return false;
+}
+
+// The identity seeds give every chosen variable its own lane
+static void load(tangent_t* tangent, artm_var_t var, double* out) {
+  memset(out, 0, tangent->lanes * sizeof(double));
+  for (size_t v = 0; v < tangent->count; ++v) {
+    if (tangent->vars[v] != var)
+      continue;
+
+    if (tangent->seeds == NULL) {
+      out[v] = 1;
+    } else {
+      binary(tangent, KERNEL_ADD, KERNEL_VV, out, out, tangent->seeds + v * tangent->lanes);
+    }
+  }
+}
+
+// The chain rule over the partial derivatives of the function. A registered
+// function has none, so they are estimated by a central difference around
+// this call only
+static void call(tangent_t* tangent, const func_t* func, double* args, double* tangents) {
+  double partials[FUNC_MAX_ARITY];
+  double value = func_call(func, args);
+  if (func->arity == 0) {
+    memset(tangents, 0, tangent->lanes * sizeof(double));
+    args[0] = value;
+    return;
+  }
+
+  if (func->kind == FUNC_UNARY) {
+    partials[0] = func->derivative.unary(args[0]);
+  } else if (func->kind == FUNC_BINARY) {
+    func->derivative.binary(args[0], args[1], partials);
+  } else {
+    for (size_t k = 0; k < func->arity; ++k) {
+      double arg = args[k];
+      double step = cbrt(DBL_EPSILON) * fmax(1, fabs(arg));
+      args[k] = arg + step;
+      double after = func_call(func, args);
+      args[k] = arg - step;
+      double before = func_call(func, args);
+      args[k] = arg;
+      partials[k] = (after - before) / (2 * step);
+    }
+  }
+
+  double* out = tangents;
+  binary(tangent, KERNEL_MUL, KERNEL_VS, out, out, &partials[0]);
+  for (size_t k = 1; k < func->arity; ++k) {
+    double* other = tangents + k * tangent->lanes;
+    binary(tangent, KERNEL_MUL, KERNEL_VS, other, other, &partials[k]);
+    binary(tangent, KERNEL_ADD, KERNEL_VV, out, out, other);
+  }
+  args[0] = value;
+}
@@ -0,0 +1,41 @@
+/* Tangent - Forward-mode derivatives of compiled programs
+ * Copyright (C) 2023 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Arithmo.
+ *
+ * Arithmo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARITHMO_TANGENT_H
+#define ARITHMO_TANGENT_H
+
+#include <stddef.h>
+
+#include "arithmo.h"
+#include "program.h"
+
+// Most programs and directions fit, so nothing is allocated for them
+#define TANGENT_STACK_SIZE 1024
+
+// Evaluates the program and its derivatives along lanes directions: seeds
+// holds the count x lanes tangents of the variables (NULL is the identity,
+// with lanes = count), and derivatives gets one value per lane
+extern artm_result_t tangent_run(
+  const program_t* program,
+  const artm_var_t* vars, size_t count,
+  const double* seeds, size_t lanes,
+  double* derivatives
+);
+
+#endif // ARITHMO_TANGENT_H
@@ -33,9 +33,12 @@ typedef enum {
 	TKN_SLASH,
 	TKN_LPAREN,
 	TKN_RPAREN,
+	TKN_COMMA,
 	TKN_EQUAL,
+	TKN_DEFINE,
 	TKN_NUMBER,
 	TKN_ID,
+	TKN_SEMI,
 	TKN_END
 } token_type_t;
 
@@ -43,6 +46,7 @@ struct token {
   token_type_t type;
   const char* target;
   size_t size;
+  double value;
 };
 
 #endif // ARITHMO_TOKEN_H